@@ -0,0 +1,96 @@
+//
+// Bareflank Hypervisor
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef BFEXITTRACE_INTEL_X64_H
+#define BFEXITTRACE_INTEL_X64_H
+
+#include <cstdint>
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+/// Exit Trace Layout
+///
+/// The binary layout of the exit trace ring shared between the VMM, which
+/// writes it, and the host, which maps it (or a copy of it) and decodes it.
+/// The ring is a header followed by num_records fixed-size records, and
+/// starts on a page boundary. Both structs are 64 bytes so that a record
+/// never straddles a cache line.
+///
+/// head is the total number of records ever written. The record with
+/// sequence number n lives at index n % num_records, so the valid records
+/// are the last min(head, num_records) before head. The VMM writes a record
+/// before it publishes the new head.
+///
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// Exit Trace Magic ("EXITTRCE")
+///
+constexpr const uint64_t exit_trace_magic = 0x4543525454495845ULL;
+
+/// Exit Trace Version
+///
+constexpr const uint64_t exit_trace_version = 1;
+
+/// Exit Trace Header
+///
+struct exit_trace_header_t {
+    uint64_t magic;             ///< exit_trace_magic
+    uint64_t version;           ///< exit_trace_version
+    uint64_t vcpuid;            ///< the vCPU that wrote the ring
+    uint64_t record_size;       ///< sizeof(exit_trace_record_t)
+    uint64_t num_records;       ///< the number of records in the ring
+    uint64_t head;              ///< the number of records ever written
+    uint64_t reserved[2];
+};
+
+/// Exit Trace Record
+///
+/// address and value depend on the exit reason:
+///
+/// - rdmsr / wrmsr: the MSR, and the value read or written
+/// - io instruction: the port, and the last value read or written
+/// - cpuid: the leaf, and the subleaf
+/// - control register accesses: the control register number
+/// - mov dr: 0, and the value written
+/// - external interrupt: the vector
+/// - EPT violation / misconfiguration: the GPA, and the guest linear address
+///
+struct exit_trace_record_t {
+    uint64_t tsc;               ///< TSC when the handler returned
+    uint64_t ticks;             ///< TSC ticks spent in the handler
+    uint64_t vcpuid;            ///< the vCPU that exited
+    uint64_t exit_reason;       ///< the basic exit reason
+    uint64_t qualification;     ///< the exit qualification (if any)
+    uint64_t address;           ///< GPA, port, MSR or leaf
+    uint64_t value;             ///< the data (if any)
+    uint64_t reserved;
+};
+
+static_assert(sizeof(exit_trace_header_t) == 64, "exit_trace_header_t must be 64 bytes");
+static_assert(sizeof(exit_trace_record_t) == 64, "exit_trace_record_t must be 64 bytes");
+
+}
+}
+
+#endif
@@ -0,0 +1,253 @@
+//
+// Bareflank Hypervisor
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <bfexittrace.h>
+
+using namespace eapis::intel_x64;
+
+// -----------------------------------------------------------------------------
+// Exit Reasons
+// -----------------------------------------------------------------------------
+
+static const std::array<const char *, 65> s_exit_reasons = {{
+    "exception_or_nmi",
+    "external_interrupt",
+    "triple_fault",
+    "init_signal",
+    "sipi",
+    "smi",
+    "other_smi",
+    "interrupt_window",
+    "nmi_window",
+    "task_switch",
+    "cpuid",
+    "getsec",
+    "hlt",
+    "invd",
+    "invlpg",
+    "rdpmc",
+    "rdtsc",
+    "rsm",
+    "vmcall",
+    "vmclear",
+    "vmlaunch",
+    "vmptrld",
+    "vmptrst",
+    "vmread",
+    "vmresume",
+    "vmwrite",
+    "vmxoff",
+    "vmxon",
+    "control_register_accesses",
+    "mov_dr",
+    "io_instruction",
+    "rdmsr",
+    "wrmsr",
+    "vm_entry_failure_invalid_guest_state",
+    "vm_entry_failure_msr_loading",
+    "unknown",
+    "mwait",
+    "monitor_trap_flag",
+    "unknown",
+    "monitor",
+    "pause",
+    "vm_entry_failure_machine_check_event",
+    "unknown",
+    "tpr_below_threshold",
+    "apic_access",
+    "virtualized_eoi",
+    "access_to_gdtr_or_idtr",
+    "access_to_ldtr_or_tr",
+    "ept_violation",
+    "ept_misconfiguration",
+    "invept",
+    "rdtscp",
+    "vmx_preemption_timer_expired",
+    "invvpid",
+    "wbinvd",
+    "xsetbv",
+    "apic_write",
+    "rdrand",
+    "invpcid",
+    "vmfunc",
+    "encls",
+    "rdseed",
+    "page_modification_log_full",
+    "xsaves",
+    "xrstors"
+}};
+
+static const char *
+exit_reason_name(uint64_t reason)
+{
+    if (reason >= s_exit_reasons.size()) {
+        return "unknown";
+    }
+
+    return s_exit_reasons.at(reason);
+}
+
+// -----------------------------------------------------------------------------
+// Decoder
+// -----------------------------------------------------------------------------
+
+static void
+print_text(const exit_trace_record_t &rec, uint64_t seq)
+{
+    std::cout << std::dec
+              << "[" << seq << "] "
+              << "vcpu " << rec.vcpuid << " "
+              << exit_reason_name(rec.exit_reason) << " (" << rec.exit_reason << ")"
+              << std::hex
+              << " tsc: 0x" << rec.tsc
+              << " qual: 0x" << rec.qualification
+              << " addr: 0x" << rec.address
+              << " value: 0x" << rec.value
+              << std::dec
+              << " ticks: " << rec.ticks << '\n';
+}
+
+static void
+print_csv(const exit_trace_record_t &rec, uint64_t seq)
+{
+    std::cout << std::dec
+              << seq << ','
+              << rec.vcpuid << ','
+              << exit_reason_name(rec.exit_reason) << ','
+              << rec.exit_reason << ','
+              << rec.tsc << ','
+              << rec.ticks << ','
+              << std::hex
+              << "0x" << rec.qualification << ','
+              << "0x" << rec.address << ','
+              << "0x" << rec.value
+              << std::dec << '\n';
+}
+
+static int
+decode(const std::vector<char> &buf, bool csv)
+{
+    exit_trace_header_t header{};
+
+    if (buf.size() < sizeof(header)) {
+        std::cerr << "error: file is too small to contain an exit trace header\n";
+        return EXIT_FAILURE;
+    }
+
+    std::memcpy(&header, buf.data(), sizeof(header));
+
+    if (header.magic != exit_trace_magic) {
+        std::cerr << "error: invalid exit trace magic\n";
+        return EXIT_FAILURE;
+    }
+
+    if (header.version != exit_trace_version) {
+        std::cerr << "error: unsupported exit trace version: " << header.version << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (header.record_size != sizeof(exit_trace_record_t)) {
+        std::cerr << "error: unsupported exit trace record size: " << header.record_size << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (header.num_records == 0 ||
+        header.num_records > (buf.size() - sizeof(header)) / sizeof(exit_trace_record_t)) {
+        std::cerr << "error: file is too small to contain " << header.num_records << " records\n";
+        return EXIT_FAILURE;
+    }
+
+    if (csv) {
+        std::cout << "seq,vcpuid,exit_reason_name,exit_reason,tsc,ticks,qualification,address,value\n";
+    }
+
+    auto first = header.head > header.num_records ? header.head - header.num_records : 0;
+    const auto *records = buf.data() + sizeof(header);
+
+    for (auto seq = first; seq < header.head; seq++) {
+        exit_trace_record_t rec{};
+
+        auto index = seq % header.num_records;
+        std::memcpy(&rec, records + (index * sizeof(rec)), sizeof(rec));
+
+        if (csv) {
+            print_csv(rec, seq);
+        }
+        else {
+            print_text(rec, seq);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+// Main
+// -----------------------------------------------------------------------------
+
+static void
+usage()
+{
+    std::cout << "usage: bftrace [--csv] <exit trace dump>\n";
+}
+
+int
+main(int argc, const char *argv[])
+{
+    auto csv = false;
+    std::string filename;
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg{argv[i]};
+
+        if (arg == "--csv") {
+            csv = true;
+            continue;
+        }
+
+        if (arg == "-h" || arg == "--help") {
+            usage();
+            return EXIT_SUCCESS;
+        }
+
+        filename = arg;
+    }
+
+    if (filename.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        std::cerr << "error: unable to open: " << filename << '\n';
+        return EXIT_FAILURE;
+    }
+
+    std::vector<char> buf{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    return decode(buf, csv);
+}
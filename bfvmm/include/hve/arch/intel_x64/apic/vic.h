@@ -19,6 +19,9 @@
 #ifndef VIC_INTEL_X64_EAPIS_H
 #define VIC_INTEL_X64_EAPIS_H
 
+#include <array>
+#include <bitset>
+
 #include <bfcapstone.h>
 
 #include <arch/intel_x64/apic/lapic.h>
@@ -128,7 +131,7 @@ public:
     /// Virtual vector to physical vector
     ///
     /// Return the _highest_priority_ physical interrupt vector the provided
-    /// virtual vector maps to.
+    /// virtual vector maps to. Reserved vectors are never returned.
     ///
     /// @expects
     /// @ensures
@@ -144,7 +147,7 @@ public:
     /// Associate the virtual interrupt vector with the given
     /// physical interrupt vector
     ///
-    /// @expects
+    /// @expects phys is not reserved with reserve_vector()
     /// @ensures
     ///
     /// @param phys the physical interrupt vector
@@ -176,6 +179,53 @@ public:
     ///
     void add_interrupt_handler(uint64_t vector, handler_delegate_t &&d);
 
+    ///
+    /// Reserve vector
+    ///
+    /// Reserves a physical interrupt vector for the VMM, e.g. for IPIs
+    /// sent between cores with send_ipi(). Interrupts at a reserved vector
+    /// are acknowledged and passed to the given delegate, whether they
+    /// arrive via vmexit or via the physical IDT, and are never injected
+    /// into the guest.
+    ///
+    /// The vector is taken out of the guest's mapping, so virt_to_phys()
+    /// never returns it and map() refuses it. Sources the guest programs
+    /// with the physical vector itself (e.g. its own IPIs, or MSIs that are
+    /// not remapped through virt_to_phys()) still raise it, so the vector
+    /// must be one the guest does not use.
+    ///
+    /// @expects vector >= 32
+    /// @ensures
+    ///
+    /// @param vector the physical interrupt vector to reserve
+    /// @param d the delegate to call when an interrupt at vector occurs
+    ///
+    void reserve_vector(uint64_t vector, handler_delegate_t &&d);
+
+    ///
+    /// Send IPI
+    ///
+    /// Sends a fixed, physical-destination IPI through the physical
+    /// x2APIC of this core.
+    ///
+    /// @expects the physical x2APIC is initialized
+    /// @ensures
+    ///
+    /// @param apic_id the x2APIC ID of the destination core
+    /// @param vector the vector of the IPI
+    ///
+    void send_ipi(uint64_t apic_id, uint64_t vector);
+
+    ///
+    /// APIC ID
+    ///
+    /// @expects the physical x2APIC is initialized
+    /// @ensures
+    ///
+    /// @return Returns the x2APIC ID of this core
+    ///
+    uint64_t apic_id() const;
+
     /// Handle interrupt
     ///
     /// This may be invoked from an interrupt arriving via vmexit
@@ -371,6 +421,8 @@ private:
     alignas(::x64::pt::page_size) std::array<uint8_t, ::x64::pt::page_size> m_regs;
     std::array<uint8_t, s_num_vectors> m_interrupt_map;
     std::array<std::list<handler_delegate_t>, s_num_vectors> m_handlers;
+    std::array<handler_delegate_t, s_num_vectors> m_reserved_handlers;
+    std::bitset<s_num_vectors> m_reserved_vectors;
 
     std::unique_ptr<uint8_t[]> m_ist1;
     std::unique_ptr<eapis::intel_x64::virt_lapic> m_virt_lapic;
@@ -21,12 +21,20 @@
 
 #include <bfgsl.h>
 
+#include <array>
+#include <atomic>
 #include <list>
 #include <unordered_map>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include <bfvmm/hve/arch/intel_x64/vmcs/vmcs.h>
 #include <bfvmm/hve/arch/intel_x64/exit_handler/exit_handler.h>
 
+#include "exit_info.h"
+
 #ifndef EAPIS_LOG_MAX
 #define EAPIS_LOG_MAX 10
 #endif
@@ -74,6 +82,197 @@ namespace eapis
 namespace intel_x64
 {
 
+class exit_stats;
+
+/// Read TSC
+///
+/// @expects
+/// @ensures
+///
+/// @return Returns the current value of the time-stamp counter
+///
+inline uint64_t
+read_tsc() noexcept
+{
+#ifdef _MSC_VER
+    return __rdtsc();
+#else
+    return __builtin_ia32_rdtsc();
+#endif
+}
+
+/// Ring Log
+///
+/// A fixed-capacity log of the N most recent records added to it. Once
+/// full, each new record overwrites the oldest one, so unlike a std::list,
+/// adding a record never allocates. Each record is stamped with the TSC at
+/// the time it was added (record.tsc).
+///
+/// A ring log has a single writer (the vCPU that owns the module), so
+/// adding a record is one relaxed atomic increment and one copy. Readers
+/// iterate from the oldest record to the newest, and may observe a record
+/// that is being overwritten if they race with the writer.
+///
+template<typename T, std::size_t N = EAPIS_LOG_MAX>
+class alignas(64) ring_log
+{
+    static_assert(N > 0, "ring_log capacity must be non-zero");
+
+public:
+
+    /// Entry
+    ///
+    /// A record along with the TSC at the time it was added
+    ///
+    struct entry_t : public T {
+
+        /// TSC
+        ///
+        /// The value of the time-stamp counter when the record was added
+        ///
+        uint64_t tsc;
+    };
+
+    /// @cond
+
+    class const_iterator
+    {
+    public:
+
+        const_iterator(const ring_log *log, uint64_t index) noexcept :
+            m_log{log},
+            m_index{index}
+        { }
+
+        const entry_t &operator*() const noexcept
+        { return m_log->m_entries[m_index % N]; }
+
+        const entry_t *operator->() const noexcept
+        { return &m_log->m_entries[m_index % N]; }
+
+        const_iterator &operator++() noexcept
+        {
+            m_index++;
+            return *this;
+        }
+
+        bool operator==(const const_iterator &other) const noexcept
+        { return m_index == other.m_index; }
+
+        bool operator!=(const const_iterator &other) const noexcept
+        { return m_index != other.m_index; }
+
+    private:
+
+        const ring_log *m_log;
+        uint64_t m_index;
+    };
+
+    /// @endcond
+
+    /// @cond
+
+    ring_log() = default;
+
+    ring_log(ring_log &&other) noexcept :
+        m_head{other.m_head.load()},
+        m_entries{other.m_entries}
+    { }
+
+    ring_log &operator=(ring_log &&other) noexcept
+    {
+        m_head = other.m_head.load();
+        m_entries = other.m_entries;
+
+        return *this;
+    }
+
+    ring_log(const ring_log &) = delete;
+    ring_log &operator=(const ring_log &) = delete;
+
+    /// @endcond
+
+    /// Push Back
+    ///
+    /// Adds a record to the log, overwriting the oldest record if the log
+    /// is full
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param record the record to add
+    ///
+    void push_back(const T &record) noexcept
+    {
+        auto &entry = m_entries[m_head.fetch_add(1, std::memory_order_relaxed) % N];
+
+        static_cast<T &>(entry) = record;
+        entry.tsc = read_tsc();
+    }
+
+    /// Begin
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns an iterator to the oldest record
+    ///
+    const_iterator begin() const noexcept
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        return {this, head > N ? head - N : 0};
+    }
+
+    /// End
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns an iterator one past the newest record
+    ///
+    const_iterator end() const noexcept
+    { return {this, m_head.load(std::memory_order_relaxed)}; }
+
+    /// Empty
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns true if no records have been added
+    ///
+    bool empty() const noexcept
+    { return m_head.load(std::memory_order_relaxed) == 0; }
+
+    /// Size
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of records in the log (at most N)
+    ///
+    std::size_t size() const noexcept
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        return head > N ? N : static_cast<std::size_t>(head);
+    }
+
+    /// Capacity
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of records the log holds before the oldest
+    ///     record is overwritten
+    ///
+    static constexpr std::size_t capacity() noexcept
+    { return N; }
+
+private:
+
+    alignas(64) std::atomic<uint64_t> m_head{0};
+    alignas(64) std::array<entry_t, N> m_entries{};
+};
+
 /// Base
 ///
 /// Provides an interface for shared features of handlers for the various
@@ -125,7 +324,7 @@ public:
     /// @ensures
     ///
     void disable_log()
-    { m_log_enabled = true; }
+    { m_log_enabled = false; }
 
     /// Dump Log
     ///
@@ -152,12 +351,42 @@ public:
     /// @param log The log to add a record to
     /// @param record The record to add to the log
     ///
-    template<typename T> void
-    add_record(std::list<T> &log, const T &record)
+    template<typename T, std::size_t N> void
+    add_record(ring_log<T, N> &log, const T &record)
+    { log.push_back(record); }
+
+    /// Handle Exit
+    ///
+    /// Calls the given handle() function of a derived class, and then
+    /// flushes the invalidations its handlers queued, so that they are
+    /// issued before the guest is resumed. Modules register this with the
+    /// base exit handler instead of their handle() function directly.
+    ///
+    /// Example:
+    /// @code
+    /// m_exit_handler->add_handler(
+    ///     exit_reason::basic_exit_reason::cpuid,
+    ///     ::handler_delegate_t::create<base, &base::handle_exit<cpuid, &cpuid::handle>>(this)
+    /// );
+    /// @endcode
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param vmcs The vmcs of the exit being handled
+    /// @return Returns the value returned by T::handle
+    ///
+    template<typename T, bool(T::*handle)(gsl::not_null<vmcs_t *>)> bool
+    handle_exit(gsl::not_null<vmcs_t *> vmcs)
     {
-        if (log.size() < EAPIS_LOG_MAX) {
-            log.push_back(record);
+        auto module = static_cast<T *>(this);
+        const auto ret = (module->*handle)(vmcs);
+
+        if (module->m_exit_stats != nullptr) {
+            module->m_exit_stats->flush_invalidations();
         }
+
+        return ret;
     }
 
 protected:
@@ -184,7 +413,7 @@ protected:
     {
         using namespace vmcs_n::exit_qualification::control_register_access;
 
-        switch (general_purpose_register::get()) {
+        switch (general_purpose_register::get(m_exit_info->qualification())) {
             case general_purpose_register::rax:
                 return vmcs->save_state()->rax;
 
@@ -260,7 +489,7 @@ protected:
     {
         using namespace vmcs_n::exit_qualification::control_register_access;
 
-        switch (general_purpose_register::get()) {
+        switch (general_purpose_register::get(m_exit_info->qualification())) {
             case general_purpose_register::rax:
                 vmcs->save_state()->rax = val;
                 return;
@@ -339,6 +568,21 @@ protected:
     //
     bool m_log_enabled{false};
 
+    /// Exit statistics
+    ///
+    /// The statistics of the hve this module belongs to, set by each derived
+    /// class that handles an exit reason, and used to time its handle()
+    ///
+    exit_stats *m_exit_stats{nullptr};
+
+    /// Exit information
+    ///
+    /// The exit information cache of the hve this module belongs to, set by
+    /// each derived class that handles an exit reason, and used to read the
+    /// fields of the exit being handled
+    ///
+    exit_info *m_exit_info{nullptr};
+
 public:
 
     /// @cond
@@ -25,6 +25,14 @@
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// Control Register Log Max
+///
+/// The number of most recent records kept in the control register log
+///
+#ifndef EAPIS_CONTROL_REGISTER_LOG_MAX
+#define EAPIS_CONTROL_REGISTER_LOG_MAX EAPIS_LOG_MAX
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -320,10 +328,10 @@ private:
         uint64_t shadow;
     };
 
-    std::list<record_t> m_cr0_log;
-    std::list<record_t> m_cr3_log;
-    std::list<record_t> m_cr4_log;
-    std::list<record_t> m_cr8_log;
+    ring_log<record_t, EAPIS_CONTROL_REGISTER_LOG_MAX> m_cr0_log;
+    ring_log<record_t, EAPIS_CONTROL_REGISTER_LOG_MAX> m_cr3_log;
+    ring_log<record_t, EAPIS_CONTROL_REGISTER_LOG_MAX> m_cr4_log;
+    ring_log<record_t, EAPIS_CONTROL_REGISTER_LOG_MAX> m_cr8_log;
 
 public:
 
@@ -25,6 +25,24 @@
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// CPUID Log Max
+///
+/// The number of most recent records kept in the cpuid log
+///
+#ifndef EAPIS_CPUID_LOG_MAX
+#define EAPIS_CPUID_LOG_MAX EAPIS_LOG_MAX
+#endif
+
+/// CPUID Cache Max
+///
+/// The maximum number of {leaf, subleaf} responses the cpuid response cache
+/// holds. Once full, new {leaf, subleaf} pairs are no longer cached (e.g.
+/// when firmware executes CPUID with garbage in RCX).
+///
+#ifndef EAPIS_CPUID_CACHE_MAX
+#define EAPIS_CPUID_CACHE_MAX 128
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -47,8 +65,8 @@ struct pair_hash {
     template <typename T1, typename T2>
     std::size_t operator()(const std::pair<T1, T2> &p) const
     {
-        return ((std::hash<T1> {}(p.first) & 0x00000000FFFFFFFF) > 0) |
-               ((std::hash<T2> {}(p.second) & 0xFFFFFFFF00000000) > 32);
+        return ((std::hash<T1> {}(p.first) & 0x00000000FFFFFFFF) << 0) |
+               ((std::hash<T2> {}(p.second) & 0x00000000FFFFFFFF) << 32);
     }
 };
 
@@ -121,6 +139,17 @@ public:
         /// default: false
         ///
         bool ignore_advance;
+
+        /// Ignore cache (out)
+        ///
+        /// If true, the response is not added to the response cache (see
+        /// enable_cache()). Set this to true if the values your handler
+        /// returns depend on guest state, so that the handlers are called
+        /// again on the next exit for the same (leaf, subleaf).
+        ///
+        /// default: false
+        ///
+        bool ignore_cache;
     };
 
     /// Handler delegate type
@@ -166,6 +195,55 @@ public:
     void add_handler(
         leaf_t leaf, subleaf_t subleaf, handler_delegate_t &&d);
 
+    /// Add CPUID Handler (All Subleaves)
+    ///
+    /// Registers a handler that is called for the given leaf regardless of
+    /// the subleaf in RCX, e.g. for leaves that do not have subleaves but
+    /// are executed by software that does not clear RCX. Handlers
+    /// registered for an exact (leaf, subleaf) are called before the
+    /// handlers registered for all subleaves of the same leaf.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param leaf the cpuid leaf to call d
+    /// @param d the handler to call when an exit occurs
+    ///
+    void add_handler(
+        leaf_t leaf, handler_delegate_t &&d);
+
+    /// Enable Cache
+    ///
+    /// Once enabled, the response to a (leaf, subleaf) is computed once,
+    /// by executing CPUID and running the registered handlers, and later
+    /// exits for the same (leaf, subleaf) are served from a table without
+    /// executing CPUID or calling the handlers again.
+    ///
+    /// Only responses whose handler returned true without setting
+    /// ignore_write, ignore_advance or ignore_cache are cached. Handlers
+    /// whose values depend on guest state must set ignore_cache. The cache
+    /// is cleared when a handler is added.
+    ///
+    /// @note leaves whose hardware values depend on the state of the
+    ///     executing CPU are never cached, regardless of ignore_cache:
+    ///     leaf 0x1 (OSXSAVE follows CR4, and EBX holds the initial APIC
+    ///     ID), leaves 0xB and 0x1F (EDX holds the x2APIC ID) and leaf 0xD
+    ///     (EBX follows XCR0 and IA32_XSS).
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void enable_cache();
+
+    /// Disable Cache
+    ///
+    /// Disables and clears the response cache
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void disable_cache();
+
 public:
 
     /// Dump Log
@@ -190,8 +268,22 @@ public:
 
 private:
 
+    bool dispatch(
+        gsl::not_null<vmcs_t *> vmcs, info_t &info, const std::list<handler_delegate_t> &hdlrs);
+
+    struct response_t {
+        uint64_t rax;
+        uint64_t rbx;
+        uint64_t rcx;
+        uint64_t rdx;
+    };
+
     exit_handler_t *m_exit_handler;
     std::unordered_map<std::pair<leaf_t, subleaf_t>, std::list<handler_delegate_t>, pair_hash> m_handlers;
+    std::unordered_map<leaf_t, std::list<handler_delegate_t>> m_leaf_handlers;
+
+    bool m_cache_enabled{false};
+    std::unordered_map<std::pair<leaf_t, subleaf_t>, response_t, pair_hash> m_cache;
 
 private:
 
@@ -204,7 +296,7 @@ private:
         uint64_t rdx;
     };
 
-    std::list<cpuid_record_t> m_log;
+    ring_log<cpuid_record_t, EAPIS_CPUID_LOG_MAX> m_log;
 
 public:
 
@@ -24,6 +24,10 @@
 #include "ept/intrinsics.h"
 #include "ept/memory_map.h"
 #include "ept/helpers.h"
+#include "ept/lazy_map.h"
+#include "ept/eptp_list.h"
+#include "ept/invalidation_manager.h"
+#include "ept/shootdown.h"
 #include "ept_violation.h"
 #include "ept_misconfiguration.h"
 
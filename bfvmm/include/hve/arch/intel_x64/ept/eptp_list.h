@@ -0,0 +1,159 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef EPTP_LIST_EPT_INTEL_X64_H
+#define EPTP_LIST_EPT_INTEL_X64_H
+
+#include "../base.h"
+#include "memory_map.h"
+
+// *INDENT-OFF*
+
+namespace eapis
+{
+namespace intel_x64
+{
+namespace ept
+{
+
+/// EPTP List
+///
+/// Provides an interface for switching between several EPT views (memory
+/// maps, usually created with the memory_map view constructor) without a
+/// VM exit. The list holds up to 512 EPTPs in a single page. Once enabled,
+/// the guest switches views with VMFUNC(0) and the index of the view, and
+/// the VMM (e.g. an exit handler) switches views with switch_to(), which
+/// writes the EPTP in the VMCS instead of rewriting entries and
+/// invalidating them.
+///
+class EXPORT_EAPIS_HVE eptp_list
+{
+public:
+
+    /// Number of Entries
+    ///
+    static constexpr const uint64_t num_entries = 512;
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    eptp_list();
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~eptp_list() = default;
+
+    /// Set
+    ///
+    /// Places mem_map in the list at index. mem_map must outlive its place
+    /// in the list.
+    ///
+    /// @expects index < num_entries
+    /// @ensures
+    ///
+    /// @param index the index of the view
+    /// @param mem_map the memory map the view translates with
+    ///
+    void set(uint64_t index, memory_map &mem_map);
+
+    /// Clear
+    ///
+    /// Removes the view at index. A VMFUNC to an empty index causes a
+    /// VM exit.
+    ///
+    /// @expects index < num_entries
+    /// @ensures
+    ///
+    /// @param index the index of the view
+    ///
+    void clear(uint64_t index);
+
+    /// EPTP
+    ///
+    /// @expects index < num_entries
+    /// @ensures
+    ///
+    /// @param index the index of the view
+    /// @return Returns the EPTP of the view at index, or 0 if the index is
+    ///     empty
+    ///
+    uint64_t eptp(uint64_t index) const;
+
+    /// HPA
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the host physical address of the list
+    ///
+    hpa_t hpa() const noexcept;
+
+    /// Enable
+    ///
+    /// Registers the list with the VMCS that is currently loaded, and
+    /// enables VM functions with EPTP switching so that the guest may
+    /// execute VMFUNC(0). EPT must already be enabled.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void enable();
+
+    /// Switch To
+    ///
+    /// Makes the view at index the active one for the VMCS that is
+    /// currently loaded, which is what VMFUNC(0) does from the guest. The
+    /// EPTP index (reported to the guest by a #VE) is updated as well.
+    /// Translations from different EPTPs are tagged separately, so no
+    /// invalidation is needed.
+    ///
+    /// @expects index < num_entries
+    /// @expects the index is not empty
+    /// @ensures
+    ///
+    /// @param index the index of the view to switch to
+    ///
+    void switch_to(uint64_t index);
+
+private:
+
+    std::unique_ptr<uint64_t[]> m_list;
+
+public:
+
+    /// @cond
+
+    eptp_list(eptp_list &&) = default;
+    eptp_list &operator=(eptp_list &&) = default;
+
+    eptp_list(const eptp_list &) = delete;
+    eptp_list &operator=(const eptp_list &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+}
+
+#endif
@@ -20,6 +20,8 @@
 #ifndef EPT_HELPERS_INTEL_X64_H
 #define EPT_HELPERS_INTEL_X64_H
 
+#include <vector>
+
 #include "../hve.h"
 #include "memory_map.h"
 #include "intrinsics.h"
@@ -63,8 +65,9 @@ uintptr_t align_2m(uintptr_t addr);
 uintptr_t align_4k(uintptr_t addr);
 
 /// Calculate the VMCS extended page table pointer (EPTP) field for the given
-/// memory map. The returned EPTP defaults to wb memory type with accessed and
-/// dirty flags disabled.
+/// memory map. The returned EPTP uses the wb memory type. Accessed and dirty
+/// flags are enabled only if the memory map has opted in to them with
+/// memory_map::enable_accessed_dirty().
 ///
 /// @expects
 /// @ensures
@@ -479,6 +482,57 @@ void map(memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, hpa_t hpa);
 ///
 void identity_map(memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e);
 
+/// Host memory region
+///
+/// Describes one region of a firmware provided memory map, e.g. an E820
+/// entry or an EFI memory descriptor, translated by the caller into one of
+/// the host_memory_type values below.
+///
+struct host_memory_region {
+    uintptr_t base;
+    uint64_t size;
+    uint64_t type;
+};
+
+namespace host_memory_type
+{
+    constexpr const auto ram = 1ULL;
+    constexpr const auto reserved = 2ULL;
+    constexpr const auto acpi_reclaimable = 3ULL;
+    constexpr const auto acpi_nvs = 4ULL;
+    constexpr const auto unusable = 5ULL;
+    constexpr const auto mmio = 6ULL;
+}
+
+/// Coalesce the regions of a host memory map that the guest needs to
+/// access: RAM (including ACPI reclaimable and NVS memory) and MMIO. All
+/// other regions, and regions with a size of 0, are dropped.
+///
+/// Regions are rounded out to 4KB boundaries and sorted, and overlapping or
+/// adjacent regions of the same type are merged into one run. Where regions
+/// of different types overlap, the part already covered by the earlier run
+/// is dropped from the later one, so the runs never overlap.
+///
+/// @expects
+/// @ensures
+///
+/// @param descriptors the host memory map, in any order
+/// @return Returns the 4KB aligned runs to map, sorted by base
+///
+std::vector<host_memory_region> coalesce(std::vector<host_memory_region> descriptors);
+
+/// Identity map the runs returned by coalesce() with ept::map(), so each
+/// run is split only where the platform's MTRRs change memory type and is
+/// mapped with the largest pages that fit.
+///
+/// @expects
+/// @ensures
+///
+/// @param mem_map the memory map to be modified
+/// @param descriptors the host memory map, in any order
+///
+void identity_map(memory_map &mem_map, std::vector<host_memory_region> descriptors);
+
 //--------------------------------------------------------------------------
 // Unmapping
 //--------------------------------------------------------------------------
@@ -0,0 +1,171 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef INVALIDATION_MANAGER_EPT_INTEL_X64_H
+#define INVALIDATION_MANAGER_EPT_INTEL_X64_H
+
+#include <vector>
+
+#include "../base.h"
+#include "memory_map.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+/// INVVPID Max Addresses
+///
+/// The number of guest virtual addresses that are invalidated one at a time
+/// with INVVPID (individual address). Once more addresses are pending, a
+/// single-context INVVPID is issued instead.
+///
+#ifndef EAPIS_INVVPID_MAX_ADDRESSES
+#define EAPIS_INVVPID_MAX_ADDRESSES 16
+#endif
+
+// *INDENT-OFF*
+
+namespace eapis
+{
+namespace intel_x64
+{
+namespace ept
+{
+
+/// EPT Invalidation Manager
+///
+/// Batches the TLB invalidations a vCPU needs after the memory map it uses
+/// changes. The memory map notifies its managers of every change by
+/// advancing its generation (see memory_map::generation()), so any number
+/// of changes made during an exit result in a single-context INVEPT when
+/// flush() is called right before the next VM entry. Guest virtual
+/// addresses whose guest page table entries were changed by the VMM are
+/// queued with invalidate_gva(), and are flushed with INVVPID unless an
+/// INVEPT already covers them.
+///
+/// INVEPT and INVVPID only affect the logical processor that executes
+/// them, so each vCPU has its own manager, and flush() must be called on
+/// the vCPU with its VMCS loaded.
+///
+class EXPORT_EAPIS_HVE invalidation_manager
+{
+public:
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param mem_map the memory map used by the vCPU's EPTP
+    ///
+    invalidation_manager(memory_map &mem_map);
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~invalidation_manager() = default;
+
+    /// Invalidate GVA
+    ///
+    /// Queues an INVVPID (individual address) for gva with the vCPU's VPID
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param gva the guest virtual address to invalidate
+    ///
+    void invalidate_gva(uint64_t gva);
+
+    /// Pending
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns true if flush() has invalidations to issue
+    ///
+    bool pending() const noexcept;
+
+    /// Flush
+    ///
+    /// Issues the pending invalidations. Does nothing if the memory map has
+    /// not changed and no GVA is queued.
+    ///
+    /// @expects the vCPU's VMCS is loaded
+    /// @ensures pending() == false
+    ///
+    void flush();
+
+    /// Requested
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of changes and GVAs that required an
+    ///     invalidation
+    ///
+    uint64_t requested() const noexcept;
+
+    /// Issued
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of INVEPT and INVVPID instructions issued
+    ///
+    uint64_t issued() const noexcept;
+
+    /// Saved
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of invalidations that were saved by
+    ///     batching, i.e. requested() - issued()
+    ///
+    uint64_t saved() const noexcept;
+
+private:
+
+    memory_map &m_mem_map;
+    uint64_t m_generation;
+
+    std::vector<uint64_t> m_gvas;
+
+    uint64_t m_requested{0};
+    uint64_t m_issued{0};
+
+public:
+
+    /// @cond
+
+    invalidation_manager(invalidation_manager &&) = delete;
+    invalidation_manager &operator=(invalidation_manager &&) = delete;
+
+    invalidation_manager(const invalidation_manager &) = delete;
+    invalidation_manager &operator=(const invalidation_manager &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,128 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef LAZY_MAP_EPT_INTEL_X64_H
+#define LAZY_MAP_EPT_INTEL_X64_H
+
+#include "../ept_violation.h"
+#include "memory_map.h"
+#include "intrinsics.h"
+#include "types.h"
+
+// *INDENT-OFF*
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+class hve;
+
+namespace ept
+{
+
+/// EPT Lazy Map
+///
+/// Populates a memory map on demand instead of up front. The memory map
+/// starts out empty (or minimally mapped), and the first EPT violation in
+/// an unmapped, naturally aligned region of up to region_size bytes
+/// identity maps that region using ept::map(), i.e. with the largest pages
+/// that fit and memory types that are consistent with the platform's MTRRs.
+/// The guest is then resumed without advancing its instruction pointer so
+/// that the faulting access is retried.
+///
+/// Violations on addresses that are already mapped, or that fall outside
+/// of [gpa_s, gpa_e], are left to the other EPT violation handlers.
+///
+/// A single memory map may be shared by several vCPUs, each with their own
+/// lazy_map. Regions are populated under a global lock so that two vCPUs
+/// faulting on the same region only map it once.
+///
+class EXPORT_EAPIS_HVE lazy_map
+{
+public:
+
+    /// Constructor
+    ///
+    /// @expects region_size is 4KB, 2MB or 1GB
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param hve the hve object whose EPT violations populate mem_map
+    /// @param mem_map the memory map to populate
+    /// @param gpa_s the first guest physical address that may be mapped
+    /// @param gpa_e the last guest physical address that may be mapped
+    ///     (inclusive)
+    /// @param region_size the largest region populated by a single fault
+    ///
+    lazy_map(
+        gsl::not_null<eapis::intel_x64::hve *> hve,
+        memory_map &mem_map,
+        gpa_t gpa_s,
+        gpa_t gpa_e,
+        uint64_t region_size = page_size_1g);
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~lazy_map() = default;
+
+    /// Faulted Regions
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of regions this lazy map has populated
+    ///
+    uint64_t faulted_regions() const noexcept;
+
+    /// @cond
+
+    bool handle(gsl::not_null<vmcs_t *> vmcs, ept_violation::info_t &info);
+
+    /// @endcond
+
+private:
+
+    memory_map &m_mem_map;
+
+    gpa_t m_gpa_s;
+    gpa_t m_gpa_e;
+    uint64_t m_region_size;
+    uint64_t m_faulted_regions{0};
+
+public:
+
+    /// @cond
+
+    lazy_map(lazy_map &&) = delete;
+    lazy_map &operator=(lazy_map &&) = delete;
+
+    lazy_map(const lazy_map &) = delete;
+    lazy_map &operator=(const lazy_map &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+}
+
+#endif
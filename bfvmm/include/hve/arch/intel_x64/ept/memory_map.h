@@ -20,11 +20,27 @@
 #ifndef MEMORY_MAP_EPT_INTEL_X64_H
 #define MEMORY_MAP_EPT_INTEL_X64_H
 
+#include <bfgsl.h>
 #include <bfmemory.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
 #include "intrinsics.h"
 #include "types.h"
 
+#ifndef EAPIS_EPT_SLAB_SIZE
+#define EAPIS_EPT_SLAB_SIZE 16
+#endif
+
+#ifndef EAPIS_EPT_CACHE_SIZE
+#define EAPIS_EPT_CACHE_SIZE 64
+#endif
+
 // -----------------------------------------------------------------------------
 // Exports
 // -----------------------------------------------------------------------------
@@ -59,6 +75,35 @@ namespace ept
 ///
 /// Provides an interface for manipulating extended page tables
 ///
+/// Page tables are handed out by an arena owned by the memory map. The arena
+/// allocates EAPIS_EPT_SLAB_SIZE zeroed, page aligned tables at a time,
+/// translates the slab once when it is physically contiguous (or each table
+/// once when it is not), and recycles tables that are freed. All of the
+/// arena's memory is released at once when the memory map is destroyed.
+///
+/// Translations performed by gpa_to_epte and gpa_to_hpa are remembered in a
+/// small direct-mapped cache (EAPIS_EPT_CACHE_SIZE entries) that is keyed by
+/// the guest physical page and the size of the leaf that maps it. The cache
+/// is invalidated by map and unmap. Callers that modify the tables by other
+/// means must call invalidate_cache or flush_cache themselves.
+///
+/// A memory map may be shared by several vCPUs. Every public function takes
+/// the memory map's lock, including gpa_to_epte and gpa_to_hpa as a lookup
+/// fills the cache, so lookups and changes can be made from any vCPU. The
+/// lock does not cover the entry returned by gpa_to_epte, map, split or
+/// unshare, which the caller must not change while another vCPU may be
+/// changing the same entry. The cache hit and miss counters are relaxed
+/// atomics that can be read without the lock.
+///
+/// Every call that changes a present entry (unmap, unmap_range, split,
+/// try_merge, unshare, set_suppress_ve, enable_suppress_ve and the
+/// harvests) advances the memory map's generation once, no matter how many
+/// entries or tables it touched, as do invalidate_cache and flush_cache.
+/// map and map_range only fill in entries that were not present, which the
+/// processor never caches, so they do not. Invalidation managers compare
+/// generations to decide whether the vCPUs using the memory map need to
+/// invalidate their EPT-derived TLB entries.
+///
 class EXPORT_EAPIS_HVE memory_map
 {
 
@@ -71,6 +116,28 @@ public:
     ///
     memory_map();
 
+    /// View Constructor
+    ///
+    /// Creates a view of base, i.e. a memory map that starts out with the
+    /// same translations as base by sharing all of its page tables. Tables
+    /// are copied on demand, so a view only costs the tables on the paths
+    /// it changes. Every function that changes entries (map, map_range,
+    /// unmap, unmap_range, split, unshare, set_suppress_ve,
+    /// enable_suppress_ve and the harvests) first copies the shared tables
+    /// it would write to, so a view never changes base. Views are switched
+    /// between with an eptp_list.
+    ///
+    /// Changes made to base show through in every view that still shares
+    /// the table that was changed. base must outlive its views, and must
+    /// not unmap or merge ranges that its views share.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param base the memory map to create a view of
+    ///
+    explicit memory_map(gsl::not_null<const memory_map *> base);
+
     /// Destructor
     ///
     /// @expects
@@ -92,8 +159,50 @@ public:
     ///
     epte_t &map(gpa_t gpa, hpa_t hpa, uint64_t size);
 
+    /// Map a range of guest physical addresses to a contiguous range of host
+    /// physical addresses using the largest page size that fits at each step,
+    /// up to max_page_size(). Each page table is walked once per range rather
+    /// than once per page.
+    ///
+    /// @expects gpa, hpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to map from
+    /// @param hpa the host physical address to map to
+    /// @param len the number of bytes to map
+    /// @param attr page table entry memory attributes to be applied to the
+    ///     mapping
+    ///
+    void map_range(gpa_t gpa, hpa_t hpa, uint64_t len,
+                   memory_attr_t attr = epte::memory_attr::wb_pt);
+
+    /// Map a range of guest physical addresses to a contiguous range of host
+    /// physical addresses using page sizes in [min_size, max_size]. The
+    /// largest size that fits is picked at each step, so passing the same
+    /// value for both forces a single page size.
+    ///
+    /// @expects gpa, hpa and len are aligned to min_size
+    /// @expects len != 0
+    /// @expects min_size <= max_size
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to map from
+    /// @param hpa the host physical address to map to
+    /// @param len the number of bytes to map
+    /// @param attr page table entry memory attributes to be applied to the
+    ///     mapping
+    /// @param min_size the smallest page size that may be used
+    /// @param max_size the largest page size that may be used
+    ///
+    void map_range(gpa_t gpa, hpa_t hpa, uint64_t len, memory_attr_t attr,
+                   uint64_t min_size, uint64_t max_size);
+
     /// Unmap a page by guest physical address
     ///
+    /// If gpa is mapped by a large page, the entire page is unmapped. Use
+    /// split() first to unmap only part of a large page.
+    ///
     /// @expects
     /// @ensures
     ///
@@ -101,6 +210,107 @@ public:
     ///
     void unmap(gpa_t gpa);
 
+    /// Unmap a range of guest physical addresses
+    ///
+    /// Clears every leaf entry in [gpa, gpa + len) and frees any page
+    /// table that is left with no present entries as a result. Tables
+    /// that are fully covered by the range are freed without visiting
+    /// their leaves. The PML4 is never freed. Unmapped holes inside the
+    /// range are skipped.
+    ///
+    /// @expects gpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to start unmapping from
+    /// @param len the number of bytes to unmap
+    /// @return the number of page tables that were reclaimed
+    ///
+    uint64_t unmap_range(gpa_t gpa, uint64_t len);
+
+    /// Unmapped size
+    ///
+    /// Returns the size of the largest naturally aligned region containing
+    /// gpa that has no mappings in this memory map, i.e. the size covered by
+    /// the first non-present entry found while walking the page tables for
+    /// gpa.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to query
+    /// @return Returns the size of the unmapped region containing gpa, or 0
+    ///     if gpa is mapped
+    ///
+    uint64_t unmapped_size(gpa_t gpa);
+
+    /// Split a large page
+    ///
+    /// Replaces the 1GB or 2MB leaf that maps gpa with a fully populated
+    /// page table whose entries map the same host physical range with the
+    /// same attributes, repeating until gpa is mapped by a page of
+    /// target_size. The new table is filled in before it is linked in, so
+    /// the translation of every address in the original page is unchanged
+    /// at all times. If gpa is already mapped at or below target_size,
+    /// nothing is changed.
+    ///
+    /// The processor may still use the large page it cached before the
+    /// split, so each vCPU using this memory map must execute a
+    /// single-context INVEPT before relying on the new entries (e.g. after
+    /// changing the permissions of the returned entry). A split advances
+    /// the generation, so an invalidation manager does this on its next
+    /// flush. Without one, the caller must issue the INVEPT.
+    ///
+    /// @expects target_size is 4KB or 2MB
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to split at
+    /// @param target_size the size of the page that should map gpa
+    /// @return Returns the leaf extended page table entry that maps gpa
+    ///
+    epte_t &split(gpa_t gpa, uint64_t target_size);
+
+    /// Merge a page table into a large page
+    ///
+    /// If the page table containing the leaf that maps gpa has 512 present
+    /// leaf entries with identical attributes that map a contiguous,
+    /// suitably aligned host physical range, the table is replaced with a
+    /// single large page and freed. This is repeated up the hierarchy for
+    /// as long as it succeeds, up to max_page_size(). The accessed and
+    /// dirty flags are not required to match and are combined.
+    ///
+    /// The freed table may still be cached by the processor, so as with
+    /// split(), each vCPU using this memory map must execute a
+    /// single-context INVEPT before the table is handed out again. A merge
+    /// advances the generation, so an invalidation manager does this on its
+    /// next flush. Without one, the caller must issue the INVEPT.
+    ///
+    /// @expects gpa is mapped
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to merge at
+    /// @return Returns true if at least one table was merged
+    ///
+    bool try_merge(gpa_t gpa);
+
+    /// Unshare
+    ///
+    /// Gives this memory map a private copy of every page table on the path
+    /// to the leaf that maps gpa with a page of the given size, splitting a
+    /// larger page on the way if needed, and returns that leaf. Changes made
+    /// to the returned entry only affect this memory map, which is needed
+    /// before changing an entry returned by gpa_to_epte() in a view.
+    ///
+    /// @expects size is 4KB, 2MB or 1GB
+    /// @expects gpa is mapped, and not with pages smaller than size
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to unshare
+    /// @param size the page size of the leaf to return
+    /// @return Returns the private leaf that maps gpa
+    ///
+    epte_t &unshare(gpa_t gpa, uint64_t size);
+
     /// Guest physical address to leaf extended page table entry
     ///
     /// @expects
@@ -154,6 +364,175 @@ public:
     ///
     uint64_t max_page_size() const;
 
+    /// Enable Accessed and Dirty Flags
+    ///
+    /// Opts this memory map in to EPT accessed and dirty flags. Once
+    /// enabled, ept::eptp() sets the A/D enable bit for this memory map and
+    /// the processor sets the accessed and dirty flags of the entries it
+    /// uses, which can then be collected with harvest_accessed() and
+    /// harvest_dirty().
+    ///
+    /// @expects the processor supports EPT accessed and dirty flags
+    /// @ensures accessed_dirty_enabled() == true
+    ///
+    void enable_accessed_dirty();
+
+    /// Accessed and Dirty Flags Enabled
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns true if EPT accessed and dirty flags are enabled
+    ///
+    bool accessed_dirty_enabled() const;
+
+    /// Harvest Accessed Flags
+    ///
+    /// Walks the present page tables covering [gpa, gpa + len) and returns
+    /// a bitmap with one bit per 4KB page, where bit n is set if the page
+    /// at gpa + (n * 4KB) was accessed since the last harvest. The accessed
+    /// flag of each leaf is cleared in the same pass. A large page reports
+    /// every 4KB page it covers and its flag is cleared for the whole page.
+    ///
+    /// Flags are cleared atomically, so a flag the processor sets on another
+    /// vCPU during the walk is either reported now or kept for the next
+    /// harvest. The processor may also cache entries with the flag set, so
+    /// the harvest invalidates this memory map's EPT-derived mappings on the
+    /// calling processor (INVEPT single context) before it returns. Other
+    /// processors using the memory map are invalidated by their invalidation
+    /// managers, as the harvest advances the generation.
+    ///
+    /// @expects gpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to start at
+    /// @param len the number of bytes to harvest
+    /// @return Returns the accessed page bitmap
+    ///
+    std::vector<uint64_t> harvest_accessed(gpa_t gpa, uint64_t len);
+
+    /// Harvest Dirty Flags
+    ///
+    /// Same as harvest_accessed(), but reports and clears the dirty flag of
+    /// each leaf instead.
+    ///
+    /// @expects gpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to start at
+    /// @param len the number of bytes to harvest
+    /// @return Returns the dirty page bitmap
+    ///
+    std::vector<uint64_t> harvest_dirty(gpa_t gpa, uint64_t len);
+
+    /// Clear Dirty Flags
+    ///
+    /// Clears the dirty flag of the leaf that maps each of the given pages,
+    /// the same way harvest_dirty() does, with a single pass over the lock,
+    /// generation and INVEPT. Pages that are no longer mapped are skipped.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param pages the guest physical addresses of the pages to clear
+    ///
+    void clear_dirty(const std::vector<gpa_t> &pages);
+
+    /// Enable Suppress #VE
+    ///
+    /// Sets the suppress #VE bit of every entry in this memory map,
+    /// present or not, and keeps it set on every entry created from now
+    /// on. This must be done before EPT-violation #VE is enabled for a
+    /// memory map, as any violation on an entry with the bit clear is
+    /// delivered to the guest as a #VE instead of causing a VM exit. Use
+    /// set_suppress_ve() to select the ranges that should be converted.
+    ///
+    /// @expects
+    /// @ensures suppress_ve_enabled() == true
+    ///
+    void enable_suppress_ve();
+
+    /// Suppress #VE Enabled
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns true if entries are created with suppress #VE set
+    ///
+    bool suppress_ve_enabled() const;
+
+    /// Set Suppress #VE
+    ///
+    /// Sets or clears the suppress #VE bit of the entries that map
+    /// [gpa, gpa + len). Present leaves and unmapped entries that are
+    /// completely covered by the range are updated. An unmapped entry
+    /// that is only partially covered is left unchanged, as it also
+    /// covers memory outside of the range. A range that only partially
+    /// covers a large page is rejected, split() the page first.
+    ///
+    /// @expects gpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to start at
+    /// @param len the number of bytes to update
+    /// @param suppress true to keep violations as VM exits, false to
+    ///     deliver them to the guest as a #VE
+    ///
+    void set_suppress_ve(gpa_t gpa, uint64_t len, bool suppress);
+
+    /// Invalidate Cache
+    ///
+    /// Removes the cached translation for the page of the given size that
+    /// contains gpa, if there is one, and advances the generation.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param gpa the guest physical address to invalidate
+    /// @param size the size of the page that maps gpa
+    ///
+    void invalidate_cache(gpa_t gpa, uint64_t size);
+
+    /// Flush Cache
+    ///
+    /// Removes every cached translation and advances the generation
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void flush_cache();
+
+    /// Cache Hits
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return The number of translations served from the cache
+    ///
+    uint64_t cache_hits() const;
+
+    /// Cache Misses
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return The number of translations that required a page walk
+    ///
+    uint64_t cache_misses() const;
+
+    /// Generation
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns a counter that is advanced on every change to the
+    ///     tables of this memory map
+    ///
+    uint64_t generation() const noexcept;
+
 #ifndef ENABLE_BUILD_TEST
 private:
 #endif
@@ -163,11 +542,49 @@ private:
     hva_t m_pml4_hva{0};
     hpa_t m_pml4_hpa{0};
     uint64_t m_cap{0};
+    bool m_accessed_dirty{false};
+    epte_t m_empty_entry{0};
     uint64_t m_max_page_size{0};
 
+    struct page_table_t {
+        hva_t hva;
+        hpa_t hpa;
+    };
+
+    std::vector<std::unique_ptr<uint8_t[]>> m_slabs;
+    std::vector<page_table_t> m_free_tables;
+    std::unordered_set<hpa_t> m_owned_tables;
+
+    struct cache_entry_t {
+        gpa_t gpa;
+        uint64_t size;
+        epte_t *entry;
+    };
+
+    std::array<cache_entry_t, EAPIS_EPT_CACHE_SIZE> m_cache{};
+    std::atomic<uint64_t> m_cache_hits{0};
+    std::atomic<uint64_t> m_cache_misses{0};
+
+    mutable std::mutex m_mutex;
+
+    std::atomic<uint64_t> m_generation{0};
+
+    epte_t *cache_lookup(gpa_t gpa, uint64_t &size);
+    void cache_insert(gpa_t gpa, uint64_t size, epte_t &entry);
+    void clear_cache(gpa_t gpa, uint64_t size);
+    void clear_cache();
+    epte_t &gpa_to_leaf(gpa_t gpa, uint64_t &size);
+
+    void allocate_slab();
+    void release_page_table(epte_t *page_table, hpa_t hpa);
+
     hpa_t allocate_page_table();
     void allocate_page_table(epte_t &entry);
-    void free_page_table(epte_t &entry);
+    uint64_t free_page_table(epte_t &entry);
+    epte_t *copy_page_table(epte_t &entry);
+    epte_t *unshare_table(epte_t &entry);
+    epte_t &private_leaf(gpa_t gpa, uint64_t &size);
+    bool owns_page_table(hpa_t hpa) const;
     void map_entry_to_page_frame(epte_t &entry, hpa_t hpa);
 
     epte_t &gpa_to_pml4e(gpa_t gpa);
@@ -175,6 +592,24 @@ private:
     epte_t &gpa_to_pde(gpa_t gpa, epte_t &pdpte);
     epte_t &gpa_to_pte(gpa_t gpa, epte_t &pde);
 
+    uint64_t map_range(epte_t *page_table, uint64_t level, gpa_t gpa,
+                       hpa_t hpa, gpa_t end, epte_t leaf,
+                       uint64_t min_size, uint64_t max_size);
+    epte_t *split_leaf(epte_t &entry, uint64_t size);
+    bool merge_table(epte_t &entry, uint64_t size);
+
+    std::vector<uint64_t> harvest(gpa_t gpa, uint64_t len, uint64_t mask);
+    void harvest(epte_t *page_table, uint64_t level, gpa_t gpa, gpa_t base,
+                 gpa_t end, uint64_t mask, std::vector<uint64_t> &bitmap);
+
+    uint64_t unmap_range(epte_t *page_table, uint64_t level, gpa_t gpa,
+                         gpa_t end, uint64_t &reclaimed);
+
+    void set_suppress_ve(epte_t *page_table, uint64_t level, gpa_t gpa,
+                         gpa_t end, bool suppress);
+    void set_suppress_ve(epte_t *page_table);
+    void clear_entry(epte_t &entry) const noexcept;
+
     epte_t &map_pdpte_to_page(gpa_t gpa, hpa_t hpa);
     epte_t &map_pde_to_page(gpa_t gpa, hpa_t hpa);
     epte_t &map_pte_to_page(gpa_t gpa, hpa_t hpa);
@@ -187,8 +622,8 @@ public:
 
     /// @cond
 
-    memory_map(memory_map &&) = default;
-    memory_map &operator=(memory_map &&) = default;
+    memory_map(memory_map &&) = delete;
+    memory_map &operator=(memory_map &&) = delete;
 
     memory_map(const memory_map &) = delete;
     memory_map &operator=(const memory_map &) = delete;
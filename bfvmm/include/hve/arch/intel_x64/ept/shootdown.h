@@ -0,0 +1,239 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef SHOOTDOWN_EPT_INTEL_X64_H
+#define SHOOTDOWN_EPT_INTEL_X64_H
+
+#include <array>
+#include <atomic>
+
+#include "../external_interrupt.h"
+#include "invalidation_manager.h"
+#include "memory_map.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+/// Shootdown Vector
+///
+/// The physical interrupt vector reserved for EPT shootdown IPIs
+///
+#ifndef EAPIS_SHOOTDOWN_VECTOR
+#define EAPIS_SHOOTDOWN_VECTOR 0xF2
+#endif
+
+/// Shootdown Max CPUs
+///
+/// The number of mailboxes, i.e. the highest vCPU id that can take part in
+/// a shootdown plus one
+///
+#ifndef EAPIS_SHOOTDOWN_MAX_CPUS
+#define EAPIS_SHOOTDOWN_MAX_CPUS 64
+#endif
+
+/// Shootdown Spin Max
+///
+/// The number of times a shootdown polls the mailboxes of the other cores
+/// before it gives up waiting for them
+///
+#ifndef EAPIS_SHOOTDOWN_SPIN_MAX
+#define EAPIS_SHOOTDOWN_SPIN_MAX 0x100000
+#endif
+
+// *INDENT-OFF*
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+class hve;
+class vic;
+
+namespace ept
+{
+
+/// EPT Shootdown
+///
+/// Invalidates the EPT-derived TLB entries of every core that uses a shared
+/// memory map after one of them changes it. Each core has a lock-free
+/// mailbox holding the memory map generation it was asked to flush up to,
+/// and the generation it has flushed up to. A shootdown posts the current
+/// generation to the mailbox of each other core and sends it an IPI on a
+/// vector reserved with the vic. The core flushes its invalidation manager
+/// from the interrupt, whether it arrives via vmexit or while in the VMM,
+/// and acknowledges by publishing the generation it flushed.
+///
+/// Cores that have already flushed up to the current generation (e.g. on
+/// their own exit) are skipped, as are cores that already have an IPI for
+/// that generation in flight, so concurrent shootdowns of the same change
+/// cost one IPI per core. The requesting core then waits a bounded amount
+/// of time for the acknowledgements, and services its own mailbox while
+/// doing so, so two cores shooting each other down do not deadlock.
+///
+/// A single shootdown object is shared by all of the cores that use the
+/// memory map, and must outlive them.
+///
+/// The VMM does not create a shootdown on its own. Without one, the other
+/// cores pick a change up on their next exit, when their invalidation
+/// managers flush. Code that shares a memory map between vCPUs and needs
+/// changes to present entries to take effect on every core before it goes
+/// on creates one for the memory map and registers each vCPU once its vic
+/// and invalidation manager exist:
+///
+/// @code
+/// // once, before the vCPUs use mem_map
+/// g_shootdown = std::make_unique<ept::shootdown>(mem_map);
+///
+/// // on each vCPU, after hve->enable_invalidation_manager(mem_map)
+/// g_shootdown->add_cpu(hve, vic, id);
+///
+/// // on the vCPU that changed mem_map
+/// g_shootdown->flush(id);
+/// @endcode
+///
+class EXPORT_EAPIS_HVE shootdown
+{
+public:
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param mem_map the memory map shared by the cores
+    ///
+    shootdown(memory_map &mem_map);
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~shootdown() = default;
+
+    /// Add CPU
+    ///
+    /// Registers the calling core, which must be the one running the vCPU
+    /// with the given id, and reserves the shootdown vector on its vic.
+    ///
+    /// @expects cpu < EAPIS_SHOOTDOWN_MAX_CPUS
+    /// @expects hve has an invalidation manager for this memory map
+    /// @ensures
+    ///
+    /// @param hve the hve of the vCPU
+    /// @param vic the vic of the vCPU
+    /// @param cpu the id of the vCPU
+    ///
+    void add_cpu(
+        gsl::not_null<eapis::intel_x64::hve *> hve,
+        gsl::not_null<eapis::intel_x64::vic *> vic,
+        uint64_t cpu);
+
+    /// Remove CPU
+    ///
+    /// @expects cpu < EAPIS_SHOOTDOWN_MAX_CPUS
+    /// @ensures
+    ///
+    /// @param cpu the id of the vCPU
+    ///
+    void remove_cpu(uint64_t cpu);
+
+    /// Flush
+    ///
+    /// Flushes the calling core's invalidation manager and shoots down the
+    /// EPT-derived TLB entries of every other registered core.
+    ///
+    /// @expects cpu was registered with add_cpu() on the calling core
+    /// @ensures
+    ///
+    /// @param cpu the id of the calling vCPU
+    /// @return Returns true if every core acknowledged, false if the wait
+    ///     timed out (the IPIs stay pending and may be waited on again)
+    ///
+    bool flush(uint64_t cpu);
+
+    /// IPIs Sent
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of shootdown IPIs sent
+    ///
+    uint64_t ipis_sent() const noexcept;
+
+    /// IPIs Skipped
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of IPIs skipped because the core had
+    ///     already flushed, or already had an IPI for the generation in
+    ///     flight
+    ///
+    uint64_t ipis_skipped() const noexcept;
+
+    /// @cond
+
+    bool handle(gsl::not_null<vmcs_t *> vmcs, external_interrupt::info_t &info);
+
+    /// @endcond
+
+#ifndef ENABLE_BUILD_TEST
+private:
+#endif
+
+    struct mailbox_t {
+        std::atomic<bool> online{false};
+        std::atomic<uint64_t> requested{0};
+        std::atomic<uint64_t> flushed{0};
+
+        uint64_t apic_id{0};
+        vmcs_t *vmcs{nullptr};
+        eapis::intel_x64::vic *vic{nullptr};
+        invalidation_manager *manager{nullptr};
+    };
+
+    void service(mailbox_t &mailbox);
+    bool post(mailbox_t &mailbox, uint64_t generation);
+
+    memory_map &m_mem_map;
+    std::array<mailbox_t, EAPIS_SHOOTDOWN_MAX_CPUS> m_mailboxes;
+
+    std::atomic<uint64_t> m_ipis_sent{0};
+    std::atomic<uint64_t> m_ipis_skipped{0};
+
+public:
+
+    /// @cond
+
+    shootdown(shootdown &&) = delete;
+    shootdown &operator=(shootdown &&) = delete;
+
+    shootdown(const shootdown &) = delete;
+    shootdown &operator=(const shootdown &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+}
+
+#endif
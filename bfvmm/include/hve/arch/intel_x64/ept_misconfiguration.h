@@ -25,6 +25,14 @@
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// EPT Misconfiguration Log Max
+///
+/// The number of most recent records kept in the EPT misconfiguration log
+///
+#ifndef EAPIS_EPT_MISCONFIGURATION_LOG_MAX
+#define EAPIS_EPT_MISCONFIGURATION_LOG_MAX EAPIS_LOG_MAX
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -135,7 +143,7 @@ private:
         uint64_t gpa;
     };
 
-    std::list<record_t> m_log;
+    ring_log<record_t, EAPIS_EPT_MISCONFIGURATION_LOG_MAX> m_log;
 
 public:
 
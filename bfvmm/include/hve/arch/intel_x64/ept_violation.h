@@ -19,12 +19,22 @@
 #ifndef EPT_VIOLATION_INTEL_X64_H
 #define EPT_VIOLATION_INTEL_X64_H
 
+#include <map>
+
 #include "base.h"
 
 // -----------------------------------------------------------------------------
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// EPT Violation Log Max
+///
+/// The number of most recent records kept in the EPT violation log
+///
+#ifndef EAPIS_EPT_VIOLATION_LOG_MAX
+#define EAPIS_EPT_VIOLATION_LOG_MAX EAPIS_LOG_MAX
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -113,6 +123,22 @@ public:
     ///
     void add_read_handler(handler_delegate_t &&d);
 
+    /// Add Read EPT Violation Handler for a GPA Range
+    ///
+    /// The handler is only called for violations whose guest physical
+    /// address falls within [gpa_s, gpa_e]. Range handlers are looked up
+    /// in O(log n) and are called before any global read handlers,
+    /// which remain as a fallback.
+    ///
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    /// @param d the handler to call when an exit occurs
+    ///
+    void add_read_handler(uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d);
+
     /// Add Write EPT Violation Handler
     ///
     /// @expects
@@ -122,6 +148,22 @@ public:
     ///
     void add_write_handler(handler_delegate_t &&d);
 
+    /// Add Write EPT Violation Handler for a GPA Range
+    ///
+    /// The handler is only called for violations whose guest physical
+    /// address falls within [gpa_s, gpa_e]. Range handlers are looked up
+    /// in O(log n) and are called before any global write handlers,
+    /// which remain as a fallback.
+    ///
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    /// @param d the handler to call when an exit occurs
+    ///
+    void add_write_handler(uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d);
+
     /// Add Execute EPT Violation Handler
     ///
     /// @expects
@@ -131,6 +173,22 @@ public:
     ///
     void add_execute_handler(handler_delegate_t &&d);
 
+    /// Add Execute EPT Violation Handler for a GPA Range
+    ///
+    /// The handler is only called for violations whose guest physical
+    /// address falls within [gpa_s, gpa_e]. Range handlers are looked up
+    /// in O(log n) and are called before any global execute handlers,
+    /// which remain as a fallback.
+    ///
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    /// @param d the handler to call when an exit occurs
+    ///
+    void add_execute_handler(uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d);
+
     /// Dump Log
     ///
     /// Example:
@@ -155,7 +213,28 @@ private:
 
     /// @endcond
 
+#ifndef ENABLE_BUILD_TEST
+private:
+#endif
+
+    // Each key is the first gpa of an interval that extends up to the next
+    // key, and maps to every handler whose range covers that interval.
+
+    using range_index_t = std::map<uint64_t, std::list<handler_delegate_t>>;
+
+    void add_range_handler(
+        range_index_t &index, uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d);
+
+    const std::list<handler_delegate_t> &range_handlers(
+        const range_index_t &index, uint64_t gpa) const;
+
+    bool dispatch(
+        gsl::not_null<vmcs_t *> vmcs, info_t &info,
+        const range_index_t &ranges, const std::list<handler_delegate_t> &hdlrs);
+
+#ifndef ENABLE_BUILD_TEST
 private:
+#endif
 
     gsl::not_null<exit_handler_t *> m_exit_handler;
 
@@ -163,6 +242,10 @@ private:
     std::list<handler_delegate_t> m_write_handlers;
     std::list<handler_delegate_t> m_execute_handlers;
 
+    range_index_t m_read_ranges;
+    range_index_t m_write_ranges;
+    range_index_t m_execute_ranges;
+
 private:
 
     struct record_t {
@@ -171,7 +254,7 @@ private:
         uint64_t exit_qualification;
     };
 
-    std::list<record_t> m_log;
+    ring_log<record_t, EAPIS_EPT_VIOLATION_LOG_MAX> m_log;
 
 public:
 
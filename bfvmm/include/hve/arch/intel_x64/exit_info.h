@@ -0,0 +1,222 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef EXIT_INFO_INTEL_X64_EAPIS_H
+#define EXIT_INFO_INTEL_X64_EAPIS_H
+
+#include <bfgsl.h>
+
+#include <array>
+
+#include <bfvmm/hve/arch/intel_x64/vmcs/vmcs.h>
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// Exit Information
+///
+/// A per-vCPU cache of the read-only VM-exit information fields of the
+/// VMCS. Each field is read (with a VMREAD) the first time it is asked for
+/// during an exit, and every later read during the same exit is served from
+/// the cache, so the modules, and the helpers in base, can all decode the
+/// same exit qualification without reading it again.
+///
+/// The cache is invalidated once the exit has been handled (the
+/// exit_stats::timer that wraps each module's handle() does this on its
+/// way out), i.e. before the VM entry that would change these fields.
+/// Only code that runs inside a module's handle() may use it.
+///
+class exit_info
+{
+public:
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    exit_info() = default;
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~exit_info() = default;
+
+    /// Exit Reason
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the exit reason field of the current exit
+    ///
+    uint64_t exit_reason()
+    {
+        return fetch<exit_reason_field>([] {
+            return ::intel_x64::vmcs::exit_reason::get();
+        });
+    }
+
+    /// Exit Qualification
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the exit qualification of the current exit
+    ///
+    uint64_t qualification()
+    {
+        return fetch<qualification_field>([] {
+            return ::intel_x64::vmcs::exit_qualification::get();
+        });
+    }
+
+    /// Instruction Length
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the VM-exit instruction length of the current exit
+    ///
+    uint64_t instruction_length()
+    {
+        return fetch<instruction_length_field>([] {
+            return ::intel_x64::vmcs::vm_exit_instruction_length::get();
+        });
+    }
+
+    /// Instruction Information
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the VM-exit instruction information of the current
+    ///     exit
+    ///
+    uint64_t instruction_information()
+    {
+        return fetch<instruction_information_field>([] {
+            return ::intel_x64::vmcs::vm_exit_instruction_information::get();
+        });
+    }
+
+    /// Guest Linear Address
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the guest linear address of the current exit
+    ///
+    uint64_t guest_linear_address()
+    {
+        return fetch<guest_linear_address_field>([] {
+            return ::intel_x64::vmcs::guest_linear_address::get();
+        });
+    }
+
+    /// Guest Physical Address
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the guest physical address of the current exit
+    ///
+    uint64_t guest_physical_address()
+    {
+        return fetch<guest_physical_address_field>([] {
+            return ::intel_x64::vmcs::guest_physical_address::get();
+        });
+    }
+
+    /// Interruption Information
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the VM-exit interruption information of the current
+    ///     exit
+    ///
+    uint64_t interruption_information()
+    {
+        return fetch<interruption_information_field>([] {
+            return ::intel_x64::vmcs::vm_exit_interruption_information::get();
+        });
+    }
+
+    /// Invalidate
+    ///
+    /// Drops every cached field, so that the next read of each field
+    /// reads the VMCS again
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void invalidate() noexcept
+    { m_valid = 0; }
+
+private:
+
+    enum field_t : uint64_t {
+        exit_reason_field,
+        qualification_field,
+        instruction_length_field,
+        instruction_information_field,
+        guest_linear_address_field,
+        guest_physical_address_field,
+        interruption_information_field,
+        num_fields
+    };
+
+    template<field_t F, typename R>
+    uint64_t fetch(R read)
+    {
+        if (GSL_UNLIKELY((m_valid & (1ULL << F)) == 0)) {
+            m_fields[F] = read();
+            m_valid |= (1ULL << F);
+        }
+
+        return m_fields[F];
+    }
+
+    uint64_t m_valid{0};
+    std::array<uint64_t, num_fields> m_fields{};
+
+public:
+
+    /// @cond
+
+    exit_info(exit_info &&) = delete;
+    exit_info &operator=(exit_info &&) = delete;
+
+    exit_info(const exit_info &) = delete;
+    exit_info &operator=(const exit_info &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
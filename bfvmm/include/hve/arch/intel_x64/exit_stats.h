@@ -0,0 +1,322 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef EXIT_STATS_INTEL_X64_EAPIS_H
+#define EXIT_STATS_INTEL_X64_EAPIS_H
+
+#include "base.h"
+#include "exit_trace.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+namespace ept
+{
+class invalidation_manager;
+}
+
+/// Exit Statistics
+///
+/// Per-vCPU counters and latency histograms for each basic exit reason.
+/// Each module's handle() times itself from entry to return using a
+/// timer, and the elapsed TSC ticks are added to the exit reason's total
+/// and to a log2 bucket of its histogram (bucket n counts exits that took
+/// [2^n, 2^(n+1)) ticks, and the last bucket also counts anything longer).
+///
+/// If an exit trace is attached (see set_trace()), the timer also writes an
+/// exit trace record with the fields the module passed to timer::trace().
+/// If an exit information cache is attached (see set_info()), the timer
+/// invalidates it, since the exit it describes has been handled. The timer
+/// never throws, so the cache is invalidated even if the handler throws.
+///
+/// If an invalidation manager is attached (see set_invalidation_manager()),
+/// base::handle_exit() flushes it once the module's handle() has returned,
+/// so every module issues the INVEPT/INVVPID its changes need before the
+/// guest is resumed.
+///
+/// Each hve owns its own statistics, which are only written by the vCPU
+/// the hve belongs to. The counters are relaxed atomics, so they are
+/// always enabled, and may be read (snapshot) or reset from any core
+/// without a lock.
+///
+class EXPORT_EAPIS_HVE exit_stats
+{
+public:
+
+    /// Number of Exit Reasons
+    ///
+    /// Basic exit reasons at or above this value are not recorded
+    ///
+    static constexpr const std::size_t num_reasons = 128;
+
+    /// Number of Buckets
+    ///
+    /// The number of log2 buckets in each histogram
+    ///
+    static constexpr const std::size_t num_buckets = 32;
+
+    /// Snapshot
+    ///
+    /// A copy of the statistics of a single exit reason
+    ///
+    struct snapshot_t {
+
+        /// Count
+        ///
+        /// The number of exits handled
+        ///
+        uint64_t count;
+
+        /// Ticks
+        ///
+        /// The total number of TSC ticks spent handling the exits
+        ///
+        uint64_t ticks;
+
+        /// Histogram
+        ///
+        /// The number of exits whose handling took [2^n, 2^(n+1)) ticks
+        ///
+        std::array<uint64_t, num_buckets> histogram;
+    };
+
+    /// Timer
+    ///
+    /// Records the time between its construction and destruction as a
+    /// single exit of the given reason. Construct one at the top of a
+    /// handle() function.
+    ///
+    class timer
+    {
+    public:
+
+        /// Constructor
+        ///
+        /// @expects
+        /// @ensures
+        ///
+        /// @param stats the statistics to record to (may be nullptr)
+        /// @param reason the basic exit reason being handled
+        ///
+        timer(exit_stats *stats, uint64_t reason) noexcept :
+            m_stats{stats},
+            m_reason{reason},
+            m_start{read_tsc()}
+        { }
+
+        /// Destructor
+        ///
+        /// @expects
+        /// @ensures
+        ///
+        ~timer()
+        {
+            if (m_stats == nullptr) {
+                return;
+            }
+
+            if (m_stats->m_info != nullptr) {
+                m_stats->m_info->invalidate();
+            }
+
+            const auto ticks = read_tsc() - m_start;
+            m_stats->record(m_reason, ticks);
+
+            if (m_stats->m_trace != nullptr) {
+                m_stats->m_trace->push(m_reason, ticks, m_qualification, m_address, m_value);
+            }
+        }
+
+        /// Trace
+        ///
+        /// Sets the fields of the exit trace record written when the timer
+        /// is destroyed. Modules fill these in from their info_t.
+        ///
+        /// @expects
+        /// @ensures
+        ///
+        /// @param qualification the exit qualification (if any)
+        /// @param address the GPA, port, MSR or leaf of the exit (if any)
+        /// @param value the data of the exit (if any)
+        ///
+        void trace(uint64_t qualification, uint64_t address, uint64_t value = 0) noexcept
+        {
+            m_qualification = qualification;
+            m_address = address;
+            m_value = value;
+        }
+
+    private:
+
+        exit_stats *m_stats;
+        uint64_t m_reason;
+        uint64_t m_start;
+
+        uint64_t m_qualification{0};
+        uint64_t m_address{0};
+        uint64_t m_value{0};
+
+    public:
+
+        /// @cond
+
+        timer(timer &&) = delete;
+        timer &operator=(timer &&) = delete;
+
+        timer(const timer &) = delete;
+        timer &operator=(const timer &) = delete;
+
+        /// @endcond
+    };
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    exit_stats() = default;
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~exit_stats() = default;
+
+    /// Record
+    ///
+    /// Adds one exit of the given reason that took the given number of
+    /// TSC ticks to handle
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param reason the basic exit reason
+    /// @param ticks the number of TSC ticks the exit took to handle
+    ///
+    void record(uint64_t reason, uint64_t ticks) noexcept;
+
+    /// Snapshot
+    ///
+    /// @expects reason < num_reasons
+    /// @ensures
+    ///
+    /// @param reason the basic exit reason
+    /// @return Returns a copy of the statistics of the given exit reason
+    ///
+    snapshot_t snapshot(uint64_t reason) const;
+
+    /// Reset
+    ///
+    /// Sets every counter of every exit reason back to 0
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void reset() noexcept;
+
+    /// Set Trace
+    ///
+    /// Attaches an exit trace that each timer writes a record to, or
+    /// detaches it if trace is nullptr
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param trace the exit trace to write to
+    ///
+    void set_trace(exit_trace *trace) noexcept;
+
+    /// Set Exit Information
+    ///
+    /// Attaches the exit information cache that each timer invalidates
+    /// once its exit has been handled, or detaches it if info is nullptr
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param info the exit information cache to invalidate
+    ///
+    void set_info(exit_info *info) noexcept;
+
+    /// Set Invalidation Manager
+    ///
+    /// Attaches the invalidation manager that base::handle_exit() flushes
+    /// once its exit has been handled, or detaches it if manager is nullptr
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param manager the invalidation manager to flush
+    ///
+    void set_invalidation_manager(ept::invalidation_manager *manager) noexcept;
+
+    /// Flush Invalidations
+    ///
+    /// Flushes the attached invalidation manager, if any
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void flush_invalidations();
+
+    /// Dump
+    ///
+    /// Prints the statistics of every exit reason that has been recorded
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void dump() const;
+
+private:
+
+    struct alignas(64) reason_t {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> ticks;
+        std::array<std::atomic<uint64_t>, num_buckets> histogram;
+    };
+
+    std::array<reason_t, num_reasons> m_reasons{};
+    exit_trace *m_trace{nullptr};
+    exit_info *m_info{nullptr};
+    ept::invalidation_manager *m_invalidation_manager{nullptr};
+
+public:
+
+    /// @cond
+
+    exit_stats(exit_stats &&) = delete;
+    exit_stats &operator=(exit_stats &&) = delete;
+
+    exit_stats(const exit_stats &) = delete;
+    exit_stats &operator=(const exit_stats &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
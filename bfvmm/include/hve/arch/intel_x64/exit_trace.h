@@ -0,0 +1,168 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef EXIT_TRACE_INTEL_X64_EAPIS_H
+#define EXIT_TRACE_INTEL_X64_EAPIS_H
+
+#include <memory>
+
+#include <bfexittrace.h>
+
+#include "base.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+/// Exit Trace Pages
+///
+/// The default size of a vCPU's exit trace ring in 4k pages. The first 64
+/// bytes hold the header, and the rest hold 64 byte records.
+///
+#ifndef EAPIS_EXIT_TRACE_PAGES
+#define EAPIS_EXIT_TRACE_PAGES 16
+#endif
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// Exit Trace
+///
+/// A per-vCPU ring of fixed-size binary exit records (see bfexittrace.h),
+/// written on the exit path without formatting anything. The ring lives in
+/// its own pages so that the host driver can map them (see hpa()) and
+/// decode the records with bftrace, either live or from a copy.
+///
+/// Records are written by the exit_stats::timer of each module's handle(),
+/// using the fields the module fills in from its info_t, once the trace is
+/// enabled with hve::enable_exit_trace().
+///
+class EXPORT_EAPIS_HVE exit_trace
+{
+public:
+
+    /// Constructor
+    ///
+    /// @expects pages > 0
+    /// @ensures the ring starts on a page boundary
+    ///
+    /// @param vcpuid the id of the vCPU that writes this trace
+    /// @param pages the size of the ring in 4k pages
+    ///
+    exit_trace(uint64_t vcpuid, uint64_t pages = EAPIS_EXIT_TRACE_PAGES);
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~exit_trace() = default;
+
+    /// Push
+    ///
+    /// Writes a record, overwriting the oldest record if the ring is full
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param reason the basic exit reason
+    /// @param ticks the number of TSC ticks the exit took to handle
+    /// @param qualification the exit qualification (if any)
+    /// @param address the GPA, port, MSR or leaf of the exit (if any)
+    /// @param value the data of the exit (if any)
+    ///
+    void push(
+        uint64_t reason,
+        uint64_t ticks,
+        uint64_t qualification,
+        uint64_t address,
+        uint64_t value) noexcept;
+
+    /// Header
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the header of the ring
+    ///
+    gsl::not_null<const exit_trace_header_t *> header() const noexcept;
+
+    /// Records
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the records of the ring, indexed by sequence number
+    ///     modulo header()->num_records
+    ///
+    gsl::not_null<const exit_trace_record_t *> records() const noexcept;
+
+    /// Pages
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the size of the ring in 4k pages
+    ///
+    uint64_t pages() const noexcept;
+
+    /// Host Physical Address
+    ///
+    /// The ring starts on a page boundary, but its pages are not guaranteed
+    /// to be physically contiguous, so the host must map each of them.
+    /// Handing these addresses to the host driver (e.g. from a vmcall
+    /// handler) is left to the extension that enables the trace.
+    ///
+    /// @expects page < pages()
+    /// @ensures
+    ///
+    /// @param page the index of the page
+    /// @return Returns the host physical address of the given page of the
+    ///     ring
+    ///
+    uintptr_t hpa(uint64_t page) const;
+
+private:
+
+    uint64_t m_pages;
+    std::unique_ptr<uint8_t[]> m_buffer;
+
+    uint8_t *m_ring;
+
+    exit_trace_header_t *m_header;
+    exit_trace_record_t *m_records;
+
+public:
+
+    /// @cond
+
+    exit_trace(exit_trace &&) = delete;
+    exit_trace &operator=(exit_trace &&) = delete;
+
+    exit_trace(const exit_trace &) = delete;
+    exit_trace &operator=(const exit_trace &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
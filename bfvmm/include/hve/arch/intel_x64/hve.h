@@ -35,6 +35,10 @@
 #include "wrmsr.h"
 #include "ept_misconfiguration.h"
 #include "ept_violation.h"
+#include "exit_stats.h"
+#include "ept/invalidation_manager.h"
+#include "pml.h"
+#include "ve.h"
 
 namespace eapis
 {
@@ -92,6 +96,49 @@ public:
     ///
     gsl::not_null<vmcs_t *> vmcs();
 
+    /// Get Exit Statistics Object
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the per-exit-reason counters and latency histograms
+    ///     of this hve's vCPU. These are always enabled.
+    ///
+    gsl::not_null<eapis::intel_x64::exit_stats *> exit_stats();
+
+    /// Get Exit Information Object
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the cache of the VM-exit information fields of the
+    ///     exit currently being handled by this hve's vCPU
+    ///
+    gsl::not_null<eapis::intel_x64::exit_info *> exit_info();
+
+    /// Get Exit Trace Object
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the exit trace object stored in the hve if exit
+    ///     tracing is enabled, otherwise an exception is thrown
+    ///
+    gsl::not_null<eapis::intel_x64::exit_trace *> exit_trace();
+
+    /// Enable Exit Trace
+    ///
+    /// Allocates a binary exit trace ring for this vCPU and has each exit
+    /// module write a record to it for every exit it handles
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param vcpuid the id of this hve's vCPU
+    /// @param pages the size of the ring in 4k pages
+    ///
+    void enable_exit_trace(uint64_t vcpuid, uint64_t pages = EAPIS_EXIT_TRACE_PAGES);
+
     //--------------------------------------------------------------------------
     // Control Register
     //--------------------------------------------------------------------------
@@ -209,6 +256,18 @@ public:
     void add_cpuid_handler(
         cpuid::leaf_t leaf, cpuid::subleaf_t subleaf, cpuid::handler_delegate_t &&d);
 
+    /// Add CPUID Handler (All Subleaves)
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param leaf the leaf to call d on
+    /// @param d the delegate to call when the guest executes CPUID at the given
+    ///        leaf, regardless of the subleaf
+    ///
+    void add_cpuid_handler(
+        cpuid::leaf_t leaf, cpuid::handler_delegate_t &&d);
+
     //--------------------------------------------------------------------------
     // External Interrupt
     //--------------------------------------------------------------------------
@@ -534,6 +593,18 @@ public:
     void add_ept_read_violation_handler(
         ept_violation::handler_delegate_t &&d);
 
+    /// Add EPT read violation handler for a GPA range
+    ///
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    /// @param d the delegate to call when an exit occurs
+    ///
+    void add_ept_read_violation_handler(
+        uint64_t gpa_s, uint64_t gpa_e, ept_violation::handler_delegate_t &&d);
+
     /// Add EPT write violation handler
     ///
     /// @expects
@@ -544,6 +615,18 @@ public:
     void add_ept_write_violation_handler(
         ept_violation::handler_delegate_t &&d);
 
+    /// Add EPT write violation handler for a GPA range
+    ///
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    /// @param d the delegate to call when an exit occurs
+    ///
+    void add_ept_write_violation_handler(
+        uint64_t gpa_s, uint64_t gpa_e, ept_violation::handler_delegate_t &&d);
+
     /// Add EPT execute violation handler
     ///
     /// @expects
@@ -554,6 +637,109 @@ public:
     void add_ept_execute_violation_handler(
         ept_violation::handler_delegate_t &&d);
 
+    /// Add EPT execute violation handler for a GPA range
+    ///
+    /// @expects gpa_s <= gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    /// @param d the delegate to call when an exit occurs
+    ///
+    void add_ept_execute_violation_handler(
+        uint64_t gpa_s, uint64_t gpa_e, ept_violation::handler_delegate_t &&d);
+
+    //--------------------------------------------------------------------------
+    // Invalidation
+    //--------------------------------------------------------------------------
+
+    /// Get Invalidation Manager Object
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the invalidation manager stored in the hve if it is
+    ///     enabled, otherwise an exception is thrown
+    ///
+    gsl::not_null<ept::invalidation_manager *> invalidation_manager();
+
+    /// Enable Invalidation Manager
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param mem_map the memory map used by this vCPU's EPTP
+    ///
+    void enable_invalidation_manager(ept::memory_map &mem_map);
+
+    /// Flush Invalidations
+    ///
+    /// Issues the invalidations pending in the invalidation manager, if it
+    /// is enabled. Every EAPIs module does this through base::handle_exit()
+    /// once its handle() has returned, i.e. after its handlers have run.
+    /// Handlers that are added to the base exit handler directly, and change
+    /// a memory map or queue a GVA, must call this themselves before
+    /// returning, as the exit handler has no hook that runs right before VM
+    /// entry.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void flush_invalidations();
+
+    //--------------------------------------------------------------------------
+    // Page-Modification Logging
+    //--------------------------------------------------------------------------
+
+    /// Get PML Object
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the PML object stored in the hve if PML is enabled,
+    ///     otherwise an exception is thrown
+    ///
+    gsl::not_null<eapis::intel_x64::pml *> pml();
+
+    /// Enable PML
+    ///
+    /// @expects mem_map.accessed_dirty_enabled() == true
+    /// @expects gpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param mem_map the memory map used by this vCPU's EPTP
+    /// @param gpa the first guest physical address to track
+    /// @param len the number of bytes to track
+    ///
+    void enable_pml(ept::memory_map &mem_map, ept::gpa_t gpa, uint64_t len);
+
+    //--------------------------------------------------------------------------
+    // Virtualization Exception
+    //--------------------------------------------------------------------------
+
+    /// Get VE Object
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the #VE object stored in the hve if #VE delivery is
+    ///     enabled, otherwise an exception is thrown
+    ///
+    gsl::not_null<eapis::intel_x64::ve *> ve();
+
+    /// Enable VE
+    ///
+    /// Enables EPT-violation #VE for this vCPU. EPT violations keep
+    /// exiting until ranges are selected with ve()->add_range().
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param mem_map the memory map used by this vCPU's EPTP
+    ///
+    void enable_ve(ept::memory_map &mem_map);
+
 
 private:
 
@@ -592,9 +778,16 @@ private:
     std::unique_ptr<eapis::intel_x64::wrmsr> m_wrmsr;
     std::unique_ptr<eapis::intel_x64::ept_misconfiguration> m_ept_misconfiguration;
     std::unique_ptr<eapis::intel_x64::ept_violation> m_ept_violation;
+    std::unique_ptr<ept::invalidation_manager> m_invalidation_manager;
+    std::unique_ptr<eapis::intel_x64::pml> m_pml;
+    std::unique_ptr<eapis::intel_x64::ve> m_ve;
 
     exit_handler_t *m_exit_handler;
     vmcs_t *m_vmcs;
+
+    eapis::intel_x64::exit_info m_exit_info;
+    eapis::intel_x64::exit_stats m_exit_stats;
+    std::unique_ptr<eapis::intel_x64::exit_trace> m_exit_trace;
 };
 
 }
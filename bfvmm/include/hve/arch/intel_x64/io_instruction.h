@@ -19,12 +19,34 @@
 #ifndef IO_INSTRUCTION_INTEL_X64_EAPIS_H
 #define IO_INSTRUCTION_INTEL_X64_EAPIS_H
 
+#include <memory>
+#include <vector>
+
 #include "base.h"
 
 // -----------------------------------------------------------------------------
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// IO Instruction Log Max
+///
+/// The number of most recent records kept in the io instruction log
+///
+#ifndef EAPIS_IO_INSTRUCTION_LOG_MAX
+#define EAPIS_IO_INSTRUCTION_LOG_MAX EAPIS_LOG_MAX
+#endif
+
+/// IO String Batch Max
+///
+/// The largest number of bytes of guest memory that are mapped to handle a
+/// single exit of a rep-prefixed INS/OUTS instruction. Longer instructions
+/// are handled in batches of this size, with the guest re-executing the
+/// instruction for the rest of its count.
+///
+#ifndef EAPIS_IO_STRING_BATCH_MAX
+#define EAPIS_IO_STRING_BATCH_MAX 0x10000
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -108,6 +130,28 @@ public:
         /// default: false
         ///
         bool ignore_advance;
+
+        /// Data (in/out)
+        ///
+        /// For rep-prefixed string instructions passed to string handlers
+        /// (see add_string_handler), the guest's buffer, mapped once for the
+        /// whole batch. It holds data.size() / (size_of_access + 1) elements.
+        ///
+        /// - For 'in' accesses, the buffer has not been read from the port
+        ///   yet. Unless ignore_write is set, it is filled by reading the port
+        ///   once per element after a handler returns true. A handler that
+        ///   emulates the port fills the buffer itself and sets ignore_write.
+        ///
+        /// - For 'out' accesses, the buffer holds the guest's elements. Unless
+        ///   ignore_write is set, each element is written to the port once a
+        ///   handler returns true.
+        ///
+        /// The port is not accessed if no string handler returns true, in
+        /// which case the access is passed to the per-element handlers.
+        ///
+        /// default: empty (per-element handlers use info.val instead)
+        ///
+        gsl::span<uint8_t> data{};
     };
 
     /// Handler delegate type
@@ -151,6 +195,52 @@ public:
         handler_delegate_t &&out_d
     );
 
+    /// Add Handler (Range)
+    ///
+    /// Registers the same handlers for every port in [port_s, port_e], so
+    /// that a device model can claim a block of ports (e.g. 0xCF8 - 0xCFF)
+    /// with a single call. Dispatch remains a single table lookup.
+    ///
+    /// @expects port_s <= port_e
+    /// @ensures
+    ///
+    /// @param port_s the first port to listen to
+    /// @param port_e the last port to listen to (inclusive)
+    /// @param in_d the handler to call when an in exit occurs
+    /// @param out_d the handler to call when an out exit occurs
+    ///
+    void add_handler(
+        vmcs_n::value_type port_s,
+        vmcs_n::value_type port_e,
+        handler_delegate_t &&in_d,
+        handler_delegate_t &&out_d
+    );
+
+    /// Add String Handler
+    ///
+    /// Registers handlers for rep-prefixed INS/OUTS instructions on the ports
+    /// in [port_s, port_e]. Instead of being called once per element with
+    /// info.val, string handlers are called once per batch with the guest's
+    /// buffer in info.data, which is mapped once instead of once per element.
+    /// String handlers are only used when a port has them, the instruction
+    /// repeats more than once and the guest's direction flag is clear. All
+    /// other accesses go to the handlers registered with add_handler().
+    ///
+    /// @expects port_s <= port_e
+    /// @ensures
+    ///
+    /// @param port_s the first port to listen to
+    /// @param port_e the last port to listen to (inclusive)
+    /// @param in_d the handler to call when a rep ins exit occurs
+    /// @param out_d the handler to call when a rep outs exit occurs
+    ///
+    void add_string_handler(
+        vmcs_n::value_type port_s,
+        vmcs_n::value_type port_e,
+        handler_delegate_t &&in_d,
+        handler_delegate_t &&out_d
+    );
+
     /// Trap On Access
     ///
     /// Sets a '1' in the MSR bitmap corresponding with the provided port. All
@@ -241,10 +331,17 @@ public:
 
     /// @endcond
 
+#ifndef ENABLE_BUILD_TEST
 private:
+#endif
 
     bool handle_in(gsl::not_null<vmcs_t *> vmcs, info_t &info);
     bool handle_out(gsl::not_null<vmcs_t *> vmcs, info_t &info);
+    bool handle_string(gsl::not_null<vmcs_t *> vmcs, info_t &info, uint64_t reps, bool in);
+
+    bool dispatch_string(
+        gsl::not_null<vmcs_t *> vmcs, info_t &info,
+        const std::vector<handler_delegate_t> &hdlrs, uint64_t count, uint64_t reps, bool in);
 
     void emulate_in(info_t &info);
     void emulate_out(info_t &info);
@@ -255,8 +352,30 @@ private:
     gsl::span<uint8_t> m_io_bitmaps;
     gsl::not_null<exit_handler_t *> m_exit_handler;
 
-    std::unordered_map<vmcs_n::value_type, std::list<handler_delegate_t>> m_in_handlers;
-    std::unordered_map<vmcs_n::value_type, std::list<handler_delegate_t>> m_out_handlers;
+    // Each port indexes into m_slots, and ports that share the same
+    // handlers share the same slot, with slot 0 starting out empty and
+    // shared by every port. The delegates of a slot are stored
+    // contiguously, most recently added last, and ports counts the ports
+    // that use the slot.
+
+    struct slot_t {
+        std::vector<handler_delegate_t> in_handlers;
+        std::vector<handler_delegate_t> out_handlers;
+        std::vector<handler_delegate_t> string_in_handlers;
+        std::vector<handler_delegate_t> string_out_handlers;
+        uint32_t ports{0};
+    };
+
+    void add_handlers(
+        vmcs_n::value_type port_s, vmcs_n::value_type port_e,
+        const handler_delegate_t &in_d, const handler_delegate_t &out_d, bool string);
+
+    uint16_t add_slot(
+        uint16_t index, uint32_t ports,
+        const handler_delegate_t &in_d, const handler_delegate_t &out_d, bool string);
+
+    std::unique_ptr<uint16_t[]> m_port_slots;
+    std::vector<slot_t> m_slots;
 
 private:
 
@@ -268,7 +387,7 @@ private:
         uint64_t val;
     };
 
-    std::list<port_record_t> m_log;
+    ring_log<port_record_t, EAPIS_IO_INSTRUCTION_LOG_MAX> m_log;
 
 public:
 
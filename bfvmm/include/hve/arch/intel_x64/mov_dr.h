@@ -25,6 +25,14 @@
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// MOV DR Log Max
+///
+/// The number of most recent records kept in the mov dr log
+///
+#ifndef EAPIS_MOV_DR_LOG_MAX
+#define EAPIS_MOV_DR_LOG_MAX EAPIS_LOG_MAX
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -146,7 +154,7 @@ private:
         uint64_t val;
     };
 
-    std::list<dr_record_t> m_log;
+    ring_log<dr_record_t, EAPIS_MOV_DR_LOG_MAX> m_log;
 
 public:
 
@@ -0,0 +1,179 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef MSR_HANDLER_TABLE_INTEL_X64_EAPIS_H
+#define MSR_HANDLER_TABLE_INTEL_X64_EAPIS_H
+
+#include <bfgsl.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// MSR Handler Table
+///
+/// Maps an MSR address to the list of delegates registered for it, in the
+/// order they should be called (most recently added first). MSRs in the two
+/// windows covered by the MSR bitmap (0x0 - 0x1FFF and
+/// 0xC0000000 - 0xC0001FFF) are looked up with a single indexed load from a
+/// dense table, and all other MSRs fall back to a small map. The delegates
+/// themselves are stored in one vector, each with the index of the next
+/// delegate registered for the same MSR, so a lookup does not hash or walk
+/// a std::list.
+///
+template<typename D>
+class msr_handler_table
+{
+    using index_type = uint16_t;
+
+public:
+
+    /// Entry
+    ///
+    /// A delegate registered for an MSR. Use next() to get the following
+    /// delegate registered for the same MSR.
+    ///
+    struct entry_t {
+        D d;
+        index_type next;
+    };
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    msr_handler_table() :
+        m_dense{std::make_unique<index_type[]>(s_dense_size)}
+    { }
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~msr_handler_table() = default;
+
+    /// Push Front
+    ///
+    /// Registers a delegate for an MSR ahead of any delegates that are
+    /// already registered for it.
+    ///
+    /// @expects fewer than 0xFFFF delegates have been registered
+    /// @ensures
+    ///
+    /// @param msr the address of the MSR
+    /// @param d the delegate to register
+    ///
+    void push_front(uint64_t msr, D &&d)
+    {
+        expects(m_entries.size() < 0xFFFF);
+
+        auto &head = this->head(msr);
+        m_entries.push_back({std::move(d), head});
+
+        head = gsl::narrow_cast<index_type>(m_entries.size());
+    }
+
+    /// Find
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param msr the address of the MSR
+    /// @return Returns the first delegate registered for the MSR, or
+    ///     nullptr if there are none
+    ///
+    const entry_t *find(uint64_t msr) const noexcept
+    {
+        if (msr <= 0x00001FFFUL) {
+            return this->at(m_dense[msr]);
+        }
+
+        if (msr - 0xC0000000UL <= 0x00001FFFUL) {
+            return this->at(m_dense[(msr - 0xC0000000UL) + 0x2000]);
+        }
+
+        const auto iter = m_overflow.find(msr);
+        return iter != m_overflow.end() ? this->at(iter->second) : nullptr;
+    }
+
+    /// Next
+    ///
+    /// @expects entry != nullptr
+    /// @ensures
+    ///
+    /// @param entry an entry returned by find() or next()
+    /// @return Returns the next delegate registered for the same MSR, or
+    ///     nullptr if there are none
+    ///
+    const entry_t *next(gsl::not_null<const entry_t *> entry) const noexcept
+    { return this->at(entry->next); }
+
+private:
+
+    static constexpr const std::size_t s_dense_size = 0x4000;
+
+    // Index 0 means "no delegate", so entries are stored at index - 1
+
+    const entry_t *at(index_type index) const noexcept
+    { return index != 0 ? &m_entries[index - 1U] : nullptr; }
+
+    index_type &head(uint64_t msr)
+    {
+        if (msr <= 0x00001FFFUL) {
+            return m_dense[msr];
+        }
+
+        if (msr - 0xC0000000UL <= 0x00001FFFUL) {
+            return m_dense[(msr - 0xC0000000UL) + 0x2000];
+        }
+
+        return m_overflow[msr];
+    }
+
+    std::unique_ptr<index_type[]> m_dense;
+    std::unordered_map<uint64_t, index_type> m_overflow;
+    std::vector<entry_t> m_entries;
+
+public:
+
+    /// @cond
+
+    msr_handler_table(msr_handler_table &&) noexcept = default;
+    msr_handler_table &operator=(msr_handler_table &&) noexcept = default;
+
+    msr_handler_table(const msr_handler_table &) = delete;
+    msr_handler_table &operator=(const msr_handler_table &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
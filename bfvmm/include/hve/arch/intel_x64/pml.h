@@ -0,0 +1,193 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef PML_INTEL_X64_EAPIS_H
+#define PML_INTEL_X64_EAPIS_H
+
+#include <vector>
+
+#include "base.h"
+#include "ept/memory_map.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+/// PML Log Max
+///
+/// The number of most recent records kept in the PML log
+///
+#ifndef EAPIS_PML_LOG_MAX
+#define EAPIS_PML_LOG_MAX EAPIS_LOG_MAX
+#endif
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+class hve;
+
+/// Page-Modification Logging (PML)
+///
+/// Provides an interface for tracking the pages the guest writes to without
+/// taking an EPT violation per page. The processor logs the guest physical
+/// address of each write that sets the dirty flag of a leaf in a 512-entry
+/// log page, and only exits once the log is full. The logged addresses are
+/// collected in a per-vCPU bitmap with one bit per 4KB page of the tracked
+/// guest physical range, which is polled with harvest(). The bitmap is
+/// allocated up front, so draining the log never allocates, and a page is
+/// kept once no matter how often it is logged. Writes to pages outside the
+/// tracked range are not reported.
+///
+/// PML is driven by the EPT dirty flags, so the memory map must have
+/// accessed and dirty flags enabled. As a page is only logged when its
+/// dirty flag goes from 0 to 1, a large page is logged once, with the
+/// address of the first write to it. Map tracked memory with 4KB pages for
+/// per-page precision.
+///
+class EXPORT_EAPIS_HVE pml : public base
+{
+public:
+
+    /// Number of Entries
+    ///
+    static constexpr const uint64_t num_entries = 512;
+
+    /// Constructor
+    ///
+    /// Allocates and registers the log page and enables PML for the VMCS
+    /// that is currently loaded.
+    ///
+    /// @expects mem_map.accessed_dirty_enabled() == true
+    /// @expects gpa and len are 4KB aligned
+    /// @expects len != 0
+    /// @ensures
+    ///
+    /// @param hve the hve object for this PML handler
+    /// @param mem_map the memory map used by the vCPU's EPTP
+    /// @param gpa the first guest physical address to track
+    /// @param len the number of bytes to track
+    ///
+    pml(
+        gsl::not_null<eapis::intel_x64::hve *> hve,
+        ept::memory_map &mem_map,
+        ept::gpa_t gpa,
+        uint64_t len
+    );
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~pml() final;
+
+public:
+
+    /// Drain
+    ///
+    /// Moves the addresses in the log page to the dirty page bitmap and
+    /// resets the log. This is done on every PML-full exit, and may be
+    /// done from any other exit to pick up a partially filled log.
+    ///
+    /// @expects the vCPU's VMCS is loaded
+    /// @ensures
+    ///
+    void drain();
+
+    /// Harvest
+    ///
+    /// Drains the log and returns the guest physical addresses of the pages
+    /// written since the last harvest. The dirty flag of each page is
+    /// cleared and EPT-derived mappings are invalidated, so the next write
+    /// to the page is logged again.
+    ///
+    /// @expects the vCPU's VMCS is loaded
+    /// @ensures
+    ///
+    /// @return Returns the 4KB aligned guest physical addresses of the
+    ///     pages written since the last harvest
+    ///
+    std::vector<uint64_t> harvest();
+
+    /// Dirty Pages
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the number of pages waiting to be harvested. Pages
+    ///     still in the log page are not counted until it is drained.
+    ///
+    uint64_t dirty_pages() const noexcept;
+
+    /// Dump Log
+    ///
+    /// Example:
+    /// @code
+    /// this->dump_log();
+    /// @endcode
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void dump_log() final;
+
+private:
+
+    bool handle(gsl::not_null<vmcs_t *> vmcs);
+
+#ifndef ENABLE_BUILD_TEST
+private:
+#endif
+
+    gsl::not_null<exit_handler_t *> m_exit_handler;
+    ept::memory_map &m_mem_map;
+
+    std::unique_ptr<uint64_t[]> m_log_page;
+
+    ept::gpa_t m_gpa;
+    uint64_t m_len;
+    uint64_t m_dirty{0};
+    std::vector<uint64_t> m_bitmap;
+
+private:
+
+    struct record_t {
+        uint64_t entries;
+    };
+
+    ring_log<record_t, EAPIS_PML_LOG_MAX> m_log;
+
+public:
+
+    /// @cond
+
+    pml(pml &&) = delete;
+    pml &operator=(pml &&) = delete;
+
+    pml(const pml &) = delete;
+    pml &operator=(const pml &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
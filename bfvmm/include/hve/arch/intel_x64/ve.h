@@ -0,0 +1,187 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VE_INTEL_X64_EAPIS_H
+#define VE_INTEL_X64_EAPIS_H
+
+#include "base.h"
+#include "ept/memory_map.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// Virtualization Exception (#VE)
+///
+/// Provides an interface for delivering EPT violations to the guest as a
+/// virtualization exception (vector 20) instead of a VM exit. Enabling #VE
+/// sets the suppress #VE bit of every entry in the memory map, so EPT
+/// violations keep exiting to the VMM by default. Violations in the ranges
+/// passed to add_range() are then delivered to the guest, which reads the
+/// details from the VE information area and re-arms it by clearing its
+/// busy field once the #VE is handled.
+///
+/// While the VE information area is busy, the processor delivers any
+/// further EPT violation as a VM exit, which is handled by the EPT
+/// violation handlers as usual.
+///
+class EXPORT_EAPIS_HVE ve
+{
+public:
+
+    /// VE Information Area
+    ///
+    /// The layout of the VE information area, as written by the processor
+    /// when it delivers a #VE
+    ///
+    struct info_t {
+        uint32_t exit_reason;
+        uint32_t busy;
+        uint64_t exit_qualification;
+        uint64_t gva;
+        uint64_t gpa;
+        uint16_t eptp_index;
+    };
+
+    /// Busy
+    ///
+    /// The value the processor writes to info_t::busy when it delivers a
+    /// #VE. The processor only delivers a #VE while the busy field is 0;
+    /// any other value makes the EPT violation a VM exit instead.
+    ///
+    static constexpr const uint32_t busy = 0xFFFFFFFFU;
+
+    /// Constructor
+    ///
+    /// Enables suppress #VE on mem_map, allocates and registers the VE
+    /// information area and enables EPT-violation #VE for the VMCS that
+    /// is currently loaded.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param mem_map the memory map used by the vCPU's EPTP
+    ///
+    ve(ept::memory_map &mem_map);
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~ve() = default;
+
+    /// Add Range
+    ///
+    /// Delivers EPT violations in [gpa_s, gpa_e] to the guest as a #VE.
+    /// As the processor may cache the suppress #VE bit of a present entry,
+    /// the caller should invalidate EPT-derived mappings (INVEPT) after
+    /// changing the ranges of a memory map that is in use.
+    ///
+    /// @expects gpa_s is 4KB aligned
+    /// @expects gpa_e + 1 is 4KB aligned
+    /// @expects gpa_s < gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    ///
+    void add_range(ept::gpa_t gpa_s, ept::gpa_t gpa_e);
+
+    /// Remove Range
+    ///
+    /// Causes EPT violations in [gpa_s, gpa_e] to exit to the VMM again.
+    /// The same invalidation requirements as add_range() apply.
+    ///
+    /// @expects gpa_s is 4KB aligned
+    /// @expects gpa_e + 1 is 4KB aligned
+    /// @expects gpa_s < gpa_e
+    /// @ensures
+    ///
+    /// @param gpa_s the first guest physical address of the range
+    /// @param gpa_e the last guest physical address of the range (inclusive)
+    ///
+    void remove_range(ept::gpa_t gpa_s, ept::gpa_t gpa_e);
+
+    /// Info
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the VE information area
+    ///
+    gsl::not_null<info_t *> info() const noexcept;
+
+    /// Info HPA
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the host physical address of the VE information
+    ///     area, which the guest needs to locate it
+    ///
+    ept::hpa_t info_hpa() const noexcept;
+
+    /// Is Armed
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns true if the next EPT violation in a #VE range will
+    ///     be delivered to the guest
+    ///
+    bool is_armed() const noexcept;
+
+    /// Arm
+    ///
+    /// Clears the busy field of the VE information area. This is normally
+    /// done by the guest's #VE handler, and is provided for guests that
+    /// ask the VMM to do it for them.
+    ///
+    /// @expects
+    /// @ensures is_armed() == true
+    ///
+    void arm() noexcept;
+
+private:
+
+    ept::memory_map &m_mem_map;
+    std::unique_ptr<uint8_t[]> m_info_page;
+
+public:
+
+    /// @cond
+
+    ve(ve &&) = delete;
+    ve &operator=(ve &&) = delete;
+
+    ve(const ve &) = delete;
+    ve &operator=(const ve &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
@@ -20,11 +20,20 @@
 #define WRMSR_INTEL_X64_EAPIS_H
 
 #include "base.h"
+#include "msr_handler_table.h"
 
 // -----------------------------------------------------------------------------
 // Definitions
 // -----------------------------------------------------------------------------
 
+/// WRMSR Log Max
+///
+/// The number of most recent records kept in the wrmsr log
+///
+#ifndef EAPIS_WRMSR_LOG_MAX
+#define EAPIS_WRMSR_LOG_MAX EAPIS_LOG_MAX
+#endif
+
 namespace eapis
 {
 namespace intel_x64
@@ -215,7 +224,7 @@ private:
     gsl::span<uint8_t> m_msr_bitmap;
     gsl::not_null<exit_handler_t *> m_exit_handler;
 
-    std::unordered_map<vmcs_n::value_type, std::list<handler_delegate_t>> m_handlers;
+    msr_handler_table<handler_delegate_t> m_handlers;
 
 private:
 
@@ -224,7 +233,7 @@ private:
         uint64_t val;
     };
 
-    std::list<msr_record_t> m_log;
+    ring_log<msr_record_t, EAPIS_WRMSR_LOG_MAX> m_log;
 
 public:
 
@@ -0,0 +1,551 @@
+
+// Bareflank Hypervisor
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef EXIT_REPLAY_EAPIS_H
+#define EXIT_REPLAY_EAPIS_H
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <vector>
+
+#include <bfexittrace.h>
+
+#include "vmcs_store.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// Exit Replay
+///
+/// Replays a stream of VM exits through the real hve dispatch path in the
+/// mocked test environment (see test_support.h), so that the cost of the
+/// exit handlers can be measured, and regression tested, without VT-x.
+///
+/// The stream is either recorded (an exit trace ring, as written by
+/// exit_trace and decoded by bftrace) or synthetic (see generate()). Before
+/// the stream is replayed, a pass-through handler is registered for every
+/// leaf, MSR, port, vector and control register the stream touches, so that
+/// each exit makes it all the way through the module that owns it. Each
+/// exit is then loaded into the mocked VMCS and handed to the exit handler.
+///
+/// The per-handler cost is taken from the hve's exit_stats, which the
+/// modules already feed, and the exit rate from the wall clock.
+///
+/// Exit reasons that no extended APIs module handles are skipped.
+///
+/// If setup_vmcs_store() has been called, exits are loaded into the
+/// in-memory VMCS store instead of g_vmcs_fields.
+///
+class exit_replay
+{
+public:
+
+    using record_t = exit_trace_record_t;
+
+    /// Result
+    ///
+    struct result_t {
+        uint64_t exits;         ///< the number of exits replayed
+        uint64_t skipped;       ///< the number of exits skipped
+        uint64_t ns;            ///< wall clock time of the replay
+
+        /// Exits Per Second
+        ///
+        /// @return Returns the number of exits replayed per second
+        ///
+        double exits_per_second() const noexcept
+        {
+            if (ns == 0) {
+                return 0.0;
+            }
+
+            return static_cast<double>(exits) * 1000000000.0 / static_cast<double>(ns);
+        }
+    };
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param hve the hve object to replay exits through
+    ///
+    exit_replay(gsl::not_null<eapis::intel_x64::hve *> hve) :
+        m_hve{hve}
+    { }
+
+    /// Destructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    ~exit_replay() = default;
+
+    /// Add Record
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param rec the exit to append to the stream
+    ///
+    void add(const record_t &rec)
+    {
+        if (!this->is_supported(rec.exit_reason)) {
+            m_skipped++;
+            return;
+        }
+
+        this->install(rec);
+        m_records.push_back(rec);
+    }
+
+    /// Load Ring
+    ///
+    /// Appends the valid records of an exit trace ring, oldest first.
+    ///
+    /// @expects ring holds a valid exit trace
+    /// @ensures
+    ///
+    /// @param ring the raw contents of an exit trace ring
+    ///
+    void load(gsl::span<const uint8_t> ring)
+    {
+        exit_trace_header_t header{};
+
+        if (static_cast<uint64_t>(ring.size()) < sizeof(header)) {
+            throw std::runtime_error("exit trace is too small");
+        }
+
+        std::memcpy(&header, ring.data(), sizeof(header));
+
+        if (header.magic != exit_trace_magic ||
+            header.version != exit_trace_version ||
+            header.record_size != sizeof(record_t)) {
+            throw std::runtime_error("invalid exit trace header");
+        }
+
+        const auto max = (static_cast<uint64_t>(ring.size()) - sizeof(header)) / sizeof(record_t);
+        if (header.num_records == 0 || header.num_records > max) {
+            throw std::runtime_error("exit trace is truncated");
+        }
+
+        auto first = header.head > header.num_records ? header.head - header.num_records : 0;
+
+        for (auto seq = first; seq < header.head; seq++) {
+            record_t rec{};
+
+            auto index = seq % header.num_records;
+            std::memcpy(&rec, ring.data() + sizeof(header) + (index * sizeof(rec)), sizeof(rec));
+
+            this->add(rec);
+        }
+    }
+
+    /// Load File
+    ///
+    /// @expects filename holds a valid exit trace
+    /// @ensures
+    ///
+    /// @param filename the name of a file holding a dump of an exit trace
+    ///     ring
+    ///
+    void load(const std::string &filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("unable to open: " + filename);
+        }
+
+        std::vector<uint8_t> buf{
+            std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()
+        };
+
+        this->load(gsl::span<const uint8_t>(buf));
+    }
+
+    /// Generate
+    ///
+    /// Appends a synthetic, deterministic mix of CPUID, MSR, port I/O, EPT,
+    /// control register, debug register and external interrupt exits.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param num the number of exits to generate
+    /// @param seed the seed of the mix
+    ///
+    void generate(uint64_t num, uint64_t seed = 1)
+    {
+        namespace reason = vmcs_n::exit_reason::basic_exit_reason;
+
+        static const std::array<record_t, 16> mix = {{
+            {0, 0, 0, reason::cpuid, 0, 0x00000000, 0, 0},
+            {0, 0, 0, reason::cpuid, 0, 0x00000001, 0, 0},
+            {0, 0, 0, reason::cpuid, 0, 0x00000007, 0, 0},
+            {0, 0, 0, reason::rdmsr, 0, 0x00000010, 0, 0},
+            {0, 0, 0, reason::rdmsr, 0, 0xC0000080, 0, 0},
+            {0, 0, 0, reason::wrmsr, 0, 0x000006E0, 0x1000, 0},
+            {0, 0, 0, reason::wrmsr, 0, 0xC0000100, 0x2000, 0},
+            {0, 0, 0, reason::io_instruction, (0x70ULL << 16), 0x70, 0x0A, 0},
+            {0, 0, 0, reason::io_instruction, (0x71ULL << 16) | 0x8, 0x71, 0, 0},
+            {0, 0, 0, reason::io_instruction, (0xCF8ULL << 16) | 0x3, 0xCF8, 0x80000000, 0},
+            {0, 0, 0, reason::io_instruction, (0xCFCULL << 16) | 0xB, 0xCFC, 0, 0},
+            {0, 0, 0, reason::ept_violation, 0x1, 0x00001000, 0x1000, 0},
+            {0, 0, 0, reason::ept_violation, 0x2, 0x00200000, 0x200000, 0},
+            {0, 0, 0, reason::control_register_accesses, 0x0, 0, 0, 0},
+            {0, 0, 0, reason::control_register_accesses, 0x4, 4, 0, 0},
+            {0, 0, 0, reason::external_interrupt, 0, 0x30, 0, 0}
+        }};
+
+        auto state = seed;
+
+        for (auto i = 0ULL; i < num; i++) {
+            state = (state * 6364136223846793005ULL) + 1442695040888963407ULL;
+            this->add(mix.at((state >> 33) % mix.size()));
+        }
+    }
+
+    /// Run
+    ///
+    /// Replays the stream, and resets the hve's exit_stats first so that
+    /// they only describe the replay.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param iterations the number of times to replay the stream
+    /// @return Returns the result of the replay
+    ///
+    result_t run(uint64_t iterations = 1)
+    {
+        auto ehlr = m_hve->exit_handler();
+        m_hve->exit_stats()->reset();
+
+        const auto start = std::chrono::steady_clock::now();
+
+        for (auto i = 0ULL; i < iterations; i++) {
+            for (const auto &rec : m_records) {
+                this->prepare(rec);
+                ehlr->handle(ehlr);
+            }
+        }
+
+        const auto stop = std::chrono::steady_clock::now();
+
+        return {
+            m_records.size() * iterations,
+            m_skipped * iterations,
+            static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()
+            )
+        };
+    }
+
+    /// Dump
+    ///
+    /// Prints the exit rate of a replay, and the cost of each handler.
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param result the result of a replay
+    ///
+    void dump(const result_t &result) const
+    {
+        std::cout << "exits:          " << result.exits << '\n';
+        std::cout << "skipped:        " << result.skipped << '\n';
+        std::cout << "time (ns):      " << result.ns << '\n';
+        std::cout << "exits / second: " << std::fixed << std::setprecision(0)
+                  << result.exits_per_second() << '\n';
+
+        for (auto reason = 0ULL; reason < exit_stats::num_reasons; reason++) {
+            const auto stats = m_hve->exit_stats()->snapshot(reason);
+
+            if (stats.count == 0) {
+                continue;
+            }
+
+            std::cout << "  reason " << std::setw(3) << reason
+                      << ": count " << stats.count
+                      << ", ticks " << stats.ticks
+                      << ", average " << stats.ticks / stats.count << '\n';
+        }
+    }
+
+    /// Records
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @return Returns the stream of exits to replay
+    ///
+    const std::vector<record_t> &records() const noexcept
+    { return m_records; }
+
+private:
+
+    template<typename I>
+    static bool passthrough(gsl::not_null<vmcs_t *> vmcs, I &info)
+    { bfignored(vmcs); bfignored(info); return true; }
+
+    static bool is_supported(uint64_t reason) noexcept
+    {
+        namespace basic = vmcs_n::exit_reason::basic_exit_reason;
+
+        switch (reason) {
+            case basic::cpuid:
+            case basic::rdmsr:
+            case basic::wrmsr:
+            case basic::io_instruction:
+            case basic::ept_violation:
+            case basic::ept_misconfiguration:
+            case basic::control_register_accesses:
+            case basic::external_interrupt:
+            case basic::mov_dr:
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    void install(const record_t &rec)
+    {
+        namespace basic = vmcs_n::exit_reason::basic_exit_reason;
+
+        // The EPT, EPT misconfiguration and MOV DR handlers are not keyed,
+        // so they only need to be registered once.
+
+        auto key = rec.address;
+
+        switch (rec.exit_reason) {
+            case basic::ept_violation:
+            case basic::ept_misconfiguration:
+            case basic::mov_dr:
+                key = 0;
+                break;
+
+            default:
+                break;
+        }
+
+        if (!m_installed.insert({rec.exit_reason, key}).second) {
+            return;
+        }
+
+        switch (rec.exit_reason) {
+            case basic::cpuid:
+                m_hve->add_cpuid_handler(
+                    gsl::narrow_cast<cpuid::leaf_t>(rec.address),
+                    cpuid::handler_delegate_t::create<passthrough<cpuid::info_t>>());
+                break;
+
+            case basic::rdmsr:
+                m_hve->add_rdmsr_handler(
+                    rec.address,
+                    rdmsr::handler_delegate_t::create<passthrough<rdmsr::info_t>>());
+                break;
+
+            case basic::wrmsr:
+                m_hve->add_wrmsr_handler(
+                    rec.address,
+                    wrmsr::handler_delegate_t::create<passthrough<wrmsr::info_t>>());
+                break;
+
+            case basic::io_instruction:
+                m_hve->add_io_instruction_handler(
+                    rec.address,
+                    io_instruction::handler_delegate_t::create<passthrough<io_instruction::info_t>>(),
+                    io_instruction::handler_delegate_t::create<passthrough<io_instruction::info_t>>());
+                break;
+
+            case basic::ept_violation:
+                m_hve->add_ept_read_violation_handler(
+                    ept_violation::handler_delegate_t::create<passthrough<ept_violation::info_t>>());
+                m_hve->add_ept_write_violation_handler(
+                    ept_violation::handler_delegate_t::create<passthrough<ept_violation::info_t>>());
+                m_hve->add_ept_execute_violation_handler(
+                    ept_violation::handler_delegate_t::create<passthrough<ept_violation::info_t>>());
+                break;
+
+            case basic::ept_misconfiguration:
+                m_hve->add_ept_misconfiguration_handler(
+                    ept_misconfiguration::handler_delegate_t::create<passthrough<ept_misconfiguration::info_t>>());
+                break;
+
+            case basic::control_register_accesses:
+                this->install_cr(rec.address);
+                break;
+
+            case basic::external_interrupt:
+                m_hve->add_external_interrupt_handler(
+                    rec.address,
+                    external_interrupt::handler_delegate_t::create<passthrough<external_interrupt::info_t>>());
+                break;
+
+            case basic::mov_dr:
+                m_hve->add_mov_dr_handler(
+                    mov_dr::handler_delegate_t::create<passthrough<mov_dr::info_t>>());
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void install_cr(uint64_t cr)
+    {
+        switch (cr) {
+            case 0:
+                m_hve->add_wrcr0_handler(
+                    control_register::handler_delegate_t::create<passthrough<control_register::info_t>>());
+                break;
+
+            case 3:
+                m_hve->add_rdcr3_handler(
+                    control_register::handler_delegate_t::create<passthrough<control_register::info_t>>());
+                m_hve->add_wrcr3_handler(
+                    control_register::handler_delegate_t::create<passthrough<control_register::info_t>>());
+                break;
+
+            case 4:
+                m_hve->add_wrcr4_handler(
+                    control_register::handler_delegate_t::create<passthrough<control_register::info_t>>());
+                break;
+
+            case 8:
+                m_hve->add_rdcr8_handler(
+                    control_register::handler_delegate_t::create<passthrough<control_register::info_t>>());
+                m_hve->add_wrcr8_handler(
+                    control_register::handler_delegate_t::create<passthrough<control_register::info_t>>());
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    static void write_field(vmcs_n::field_type field, vmcs_n::value_type value)
+    {
+        if (g_vmcs_store != nullptr) {
+            g_vmcs_store->write(field, value);
+            return;
+        }
+
+        g_vmcs_fields[field] = value;
+    }
+
+    void prepare(const record_t &rec)
+    {
+        namespace basic = vmcs_n::exit_reason::basic_exit_reason;
+
+        auto state = m_hve->vmcs()->save_state();
+
+        write_field(vmcs_n::exit_reason::addr, rec.exit_reason);
+        write_field(vmcs_n::exit_qualification::addr, rec.qualification);
+        write_field(vmcs_n::vm_exit_instruction_length::addr, 2);
+
+        switch (rec.exit_reason) {
+            case basic::cpuid:
+                state->rax = rec.address;
+                state->rcx = rec.value;
+                break;
+
+            case basic::rdmsr:
+                state->rcx = rec.address;
+                break;
+
+            case basic::wrmsr:
+                state->rcx = rec.address;
+                state->rax = rec.value & 0x00000000FFFFFFFFULL;
+                state->rdx = rec.value >> 32;
+                break;
+
+            case basic::io_instruction:
+                if (rec.qualification == 0) {
+                    write_field(vmcs_n::exit_qualification::addr, rec.address << 16);
+                }
+
+                state->rax = rec.value;
+                break;
+
+            case basic::ept_violation:
+            case basic::ept_misconfiguration:
+                write_field(vmcs_n::guest_physical_address::addr, rec.address);
+                write_field(vmcs_n::guest_linear_address::addr, rec.value);
+                break;
+
+            case basic::control_register_accesses:
+                if (rec.qualification == 0) {
+                    write_field(vmcs_n::exit_qualification::addr, rec.address);
+                }
+                break;
+
+            case basic::external_interrupt:
+                write_field(
+                    vmcs_n::vm_exit_interruption_information::addr,
+                    (1ULL << 31) | (rec.address & 0xFFULL));
+                break;
+
+            case basic::mov_dr:
+                write_field(vmcs_n::exit_qualification::addr, 7);
+                state->rax = rec.value;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+private:
+
+    eapis::intel_x64::hve *m_hve;
+
+    uint64_t m_skipped{0};
+    std::vector<record_t> m_records;
+    std::set<std::pair<uint64_t, uint64_t>> m_installed;
+
+public:
+
+    /// @cond
+
+    exit_replay(exit_replay &&) = default;
+    exit_replay &operator=(exit_replay &&) = default;
+
+    exit_replay(const exit_replay &) = delete;
+    exit_replay &operator=(const exit_replay &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+#endif
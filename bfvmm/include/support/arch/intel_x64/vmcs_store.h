@@ -0,0 +1,319 @@
+
+// Bareflank Hypervisor
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VMCS_STORE_EAPIS_H
+#define VMCS_STORE_EAPIS_H
+
+#include <memory>
+#include <unordered_map>
+
+#include "test_support.h"
+
+// -----------------------------------------------------------------------------
+// Definitions
+// -----------------------------------------------------------------------------
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+/// VMCS Store
+///
+/// An in-memory model of the VMCS. VMCS field encodings are 15 bits wide,
+/// so every field has its own slot in a flat table, and a read or write is
+/// a single array access instead of a std::map lookup.
+///
+class vmcs_store
+{
+public:
+
+    /// @cond
+
+    using field_type = ::intel_x64::vmcs::field_type;
+    using value_type = ::intel_x64::vmcs::value_type;
+
+    /// @endcond
+
+    /// Maximum number of fields
+    ///
+    static constexpr const field_type num_fields = 0x8000;
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    vmcs_store() :
+        m_fields{std::make_unique<value_type[]>(num_fields)}
+    { }
+
+    /// Read
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param field the field to read
+    /// @param value where to store the value of the field
+    /// @return Returns false if field is not a valid encoding, true otherwise
+    ///
+    bool read(field_type field, value_type *value) const noexcept
+    {
+        if (GSL_UNLIKELY(field >= num_fields)) {
+            return false;
+        }
+
+        *value = m_fields[field];
+        return true;
+    }
+
+    /// Write
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param field the field to write
+    /// @param value the value to write
+    /// @return Returns false if field is not a valid encoding, true otherwise
+    ///
+    bool write(field_type field, value_type value) noexcept
+    {
+        if (GSL_UNLIKELY(field >= num_fields)) {
+            return false;
+        }
+
+        m_fields[field] = value;
+        return true;
+    }
+
+    /// Clear
+    ///
+    /// Sets every field to 0
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void clear() noexcept
+    {
+        for (auto i = 0ULL; i < num_fields; i++) {
+            m_fields[i] = 0;
+        }
+    }
+
+private:
+
+    std::unique_ptr<value_type[]> m_fields;
+
+public:
+
+    /// @cond
+
+    vmcs_store(vmcs_store &&) = default;
+    vmcs_store &operator=(vmcs_store &&) = default;
+
+    vmcs_store(const vmcs_store &) = delete;
+    vmcs_store &operator=(const vmcs_store &) = delete;
+
+    /// @endcond
+};
+
+/// MSR Store
+///
+/// An in-memory model of the MSRs. The two ranges covered by the MSR
+/// bitmaps (0x0 - 0x1FFF and 0xC0000000 - 0xC0001FFF), which hold nearly
+/// every MSR a guest touches, are stored in flat tables. Any other MSR
+/// falls back to a hash map.
+///
+class msr_store
+{
+public:
+
+    /// @cond
+
+    using field_type = ::x64::msrs::field_type;
+    using value_type = ::x64::msrs::value_type;
+
+    /// @endcond
+
+    /// Size of each flat range
+    ///
+    static constexpr const field_type range_size = 0x2000;
+
+    /// Constructor
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    msr_store() :
+        m_lo{std::make_unique<value_type[]>(range_size)},
+        m_hi{std::make_unique<value_type[]>(range_size)}
+    { }
+
+    /// Read
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param msr the MSR to read
+    /// @return Returns the value of the MSR (0 if never written)
+    ///
+    value_type read(field_type msr) const
+    {
+        if (msr < range_size) {
+            return m_lo[msr];
+        }
+
+        if (msr >= 0xC0000000U && msr < 0xC0000000U + range_size) {
+            return m_hi[msr - 0xC0000000U];
+        }
+
+        const auto iter = m_other.find(msr);
+        return iter != m_other.end() ? iter->second : 0;
+    }
+
+    /// Write
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    /// @param msr the MSR to write
+    /// @param value the value to write
+    ///
+    void write(field_type msr, value_type value)
+    {
+        if (msr < range_size) {
+            m_lo[msr] = value;
+            return;
+        }
+
+        if (msr >= 0xC0000000U && msr < 0xC0000000U + range_size) {
+            m_hi[msr - 0xC0000000U] = value;
+            return;
+        }
+
+        m_other[msr] = value;
+    }
+
+    /// Clear
+    ///
+    /// Sets every MSR to 0
+    ///
+    /// @expects
+    /// @ensures
+    ///
+    void clear() noexcept
+    {
+        for (auto i = 0U; i < range_size; i++) {
+            m_lo[i] = 0;
+            m_hi[i] = 0;
+        }
+
+        m_other.clear();
+    }
+
+private:
+
+    std::unique_ptr<value_type[]> m_lo;
+    std::unique_ptr<value_type[]> m_hi;
+    std::unordered_map<field_type, value_type> m_other;
+
+public:
+
+    /// @cond
+
+    msr_store(msr_store &&) = default;
+    msr_store &operator=(msr_store &&) = default;
+
+    msr_store(const msr_store &) = delete;
+    msr_store &operator=(const msr_store &) = delete;
+
+    /// @endcond
+};
+
+}
+}
+
+// -----------------------------------------------------------------------------
+// Test Support
+// -----------------------------------------------------------------------------
+
+std::unique_ptr<eapis::intel_x64::vmcs_store> g_vmcs_store;
+std::unique_ptr<eapis::intel_x64::msr_store> g_msr_store;
+
+inline bool
+vmcs_store_vmread(uint64_t field, uint64_t *value) noexcept
+{ return g_vmcs_store->read(field, value); }
+
+inline bool
+vmcs_store_vmwrite(uint64_t field, uint64_t value) noexcept
+{ return g_vmcs_store->write(field, value); }
+
+inline uint64_t
+msr_store_read_msr(uint32_t addr) noexcept
+{ return g_msr_store->read(addr); }
+
+inline void
+msr_store_write_msr(uint32_t addr, uint64_t value) noexcept
+{ g_msr_store->write(addr, value); }
+
+/// Setup VMCS Store
+///
+/// Routes every VMCS and MSR access made through the intrinsics to the
+/// in-memory stores above, instead of the std::map based g_vmcs_fields and
+/// g_msrs, so that exit loops run at native speed. The stores start out as
+/// a copy of g_vmcs_fields and g_msrs, so call this after setup_hve() and
+/// any other setup that writes them, and use the intrinsics (or
+/// g_vmcs_store and g_msr_store) to change state from then on.
+///
+/// The routing lasts as long as both mocks and the returned guard do.
+/// Declare the guard after mocks so that it is destroyed first.
+///
+/// @param mocks the mock repository of the test
+/// @return Returns a guard that removes the stores when it is destroyed
+///
+inline auto
+setup_vmcs_store(MockRepository &mocks)
+{
+    struct guard_t {
+        ~guard_t()
+        {
+            g_vmcs_store.reset();
+            g_msr_store.reset();
+        }
+    };
+
+    g_vmcs_store = std::make_unique<eapis::intel_x64::vmcs_store>();
+    g_msr_store = std::make_unique<eapis::intel_x64::msr_store>();
+
+    for (const auto &field : g_vmcs_fields) {
+        g_vmcs_store->write(field.first, field.second);
+    }
+
+    for (const auto &msr : g_msrs) {
+        g_msr_store->write(msr.first, msr.second);
+    }
+
+    mocks.OnCallFunc(_vmread).Do(vmcs_store_vmread);
+    mocks.OnCallFunc(_vmwrite).Do(vmcs_store_vmwrite);
+    mocks.OnCallFunc(_read_msr).Do(msr_store_read_msr);
+    mocks.OnCallFunc(_write_msr).Do(msr_store_write_msr);
+
+    return std::make_unique<guard_t>();
+}
+
+#endif
@@ -23,6 +23,8 @@
 
 #include "../../../hve/arch/intel_x64/hve.h"
 #include "../../../hve/arch/intel_x64/apic/vic.h"
+#include "../../../hve/arch/intel_x64/ept/helpers.h"
+#include "../../../hve/arch/intel_x64/ept/lazy_map.h"
 #include "../../../hve/arch/intel_x64/ept/memory_map.h"
 
 namespace eapis
@@ -84,13 +86,60 @@ public:
     ///
     gsl::not_null<eapis::intel_x64::ept::memory_map *> emm();
 
+    /// Set EMM (EPT memory map)
+    ///
+    /// By default, enable_efi() points every vCPU at a single, host-wide
+    /// memory map. Calling this before enable_efi() overrides that for
+    /// this vCPU only. The caller is responsible for populating the given
+    /// memory map; enable_efi() does not identity map it.
+    ///
+    /// @expects emm != nullptr
+    /// @expects enable_efi() has not been called
+    /// @ensures
+    ///
+    /// @param emm the memory map this vCPU should use
+    ///
+    void set_emm(std::shared_ptr<eapis::intel_x64::ept::memory_map> emm);
+
+    /// Set EFI Memory Map
+    ///
+    /// Provides the host memory map (e.g. from E820 or the EFI memory map)
+    /// that the shared EFI memory map is built from. Only RAM, ACPI and
+    /// MMIO regions are mapped. If no host memory map is provided, guest
+    /// physical memory from 0 to 36GB is identity mapped instead.
+    ///
+    /// @expects must be called before the first vCPU calls enable_efi()
+    /// @ensures
+    ///
+    /// @param descriptors the host memory map
+    ///
+    static void set_efi_memory_map(
+        std::vector<eapis::intel_x64::ept::host_memory_region> descriptors);
+
+    /// Set EFI Lazy EPT
+    ///
+    /// If enabled, and no host memory map has been provided with
+    /// set_efi_memory_map(), the shared EFI memory map starts out empty and
+    /// each vCPU populates it on demand from EPT violations (see
+    /// ept::lazy_map) instead of identity mapping 0 to 36GB up front.
+    ///
+    /// @expects must be called before the first vCPU calls enable_efi()
+    /// @ensures
+    ///
+    /// @param enabled true to populate the EFI memory map lazily
+    ///
+    static void set_efi_lazy_ept(bool enabled);
+
     /// Enable EFI
     ///
     /// Install and enable the exit handlers required to boot
     /// multi-core Linux
     ///
     /// @note enabling this will enable the vic, ept, and vpid
-    /// By default, all of guest physical memory is identity mapped.
+    /// By default, all of guest physical memory is identity mapped using a
+    /// single memory map that is shared by every vCPU. It is created by the
+    /// first vCPU to enable EFI and released with the last vCPU that uses
+    /// it. See set_emm() to give a vCPU its own memory map instead.
     ///
     /// @expects get_platform_info()->efi.enabled == true
     /// @ensures
@@ -110,9 +159,10 @@ private:
     bool efi_handle_init_signal(gsl::not_null<vmcs_t *> vmcs);
     bool efi_handle_sipi(gsl::not_null<vmcs_t *> vmcs);
 
-    std::unique_ptr<eapis::intel_x64::ept::memory_map> m_emm;
+    std::shared_ptr<eapis::intel_x64::ept::memory_map> m_emm;
     std::unique_ptr<eapis::intel_x64::hve> m_hve;
     std::unique_ptr<eapis::intel_x64::vic> m_vic;
+    std::unique_ptr<eapis::intel_x64::ept::lazy_map> m_lazy_map;
 };
 
 }
@@ -112,7 +112,7 @@ uint64_t
 vic::virt_to_phys(uint64_t virt)
 {
     for (auto phys = 255ULL; phys >= 32ULL; --phys) {
-        if (m_interrupt_map.at(phys) == virt) {
+        if (m_interrupt_map.at(phys) == virt && !m_reserved_vectors.test(phys)) {
             return phys;
         }
     }
@@ -122,7 +122,10 @@ vic::virt_to_phys(uint64_t virt)
 
 void
 vic::map(uint64_t phys, uint64_t virt)
-{ m_interrupt_map.at(phys) = gsl::narrow_cast<uint8_t>(virt); }
+{
+    expects(!m_reserved_vectors.test(phys));
+    m_interrupt_map.at(phys) = gsl::narrow_cast<uint8_t>(virt);
+}
 
 void
 vic::unmap(uint64_t virt)
@@ -196,7 +199,9 @@ void
 vic::init_interrupt_map()
 {
     for (auto i = 0ULL; i < s_num_vectors; ++i) {
-        this->map(i, i);
+        if (!m_reserved_vectors.test(i)) {
+            this->map(i, i);
+        }
     }
 }
 
@@ -546,6 +551,14 @@ void
 vic::handle_interrupt(uint64_t phys)
 {
     m_phys_lapic->write_eoi();
+
+    if (m_reserved_vectors.test(phys)) {
+        external_interrupt::info_t info = {phys};
+        m_reserved_handlers.at(phys)(m_hve->vmcs(), info);
+
+        return;
+    }
+
     m_virt_lapic->queue_injection(this->phys_to_virt(phys));
 }
 
@@ -553,5 +566,34 @@ void
 vic::add_interrupt_handler(uint64_t vector, handler_delegate_t &&d)
 { m_handlers.at(vector).push_front(d); }
 
+void
+vic::reserve_vector(uint64_t vector, handler_delegate_t &&d)
+{
+    expects(vector >= 32U && vector < s_num_vectors);
+
+    m_reserved_handlers.at(vector) = std::move(d);
+    m_reserved_vectors.set(vector);
+    m_interrupt_map.at(vector) = 0U;
+}
+
+void
+vic::send_ipi(uint64_t apic_id, uint64_t vector)
+{
+    expects(m_phys_lapic);
+
+    // Fixed delivery mode, physical destination mode and level assert, with
+    // the destination in the upper 32 bits of the x2APIC ICR.
+
+    constexpr const auto level_assert = 1ULL << 14U;
+    m_phys_lapic->write_icr((apic_id << 32U) | level_assert | (vector & 0xFFU));
+}
+
+uint64_t
+vic::apic_id() const
+{
+    expects(m_phys_lapic);
+    return m_phys_lapic->read_id();
+}
+
 }
 }
@@ -36,9 +36,12 @@ control_register::control_register(
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::control_register_accesses,
-        ::handler_delegate_t::create<control_register, &control_register::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<control_register, &control_register::handle>>(this)
     );
 
     this->add_wrcr0_handler(
@@ -164,6 +167,7 @@ control_register::dump_log()
 
             for (const auto &record : m_cr0_log) {
                 bfdebug_info(0, "record", msg);
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
                 bfdebug_subnhex(0, "val", record.val, msg);
                 bfdebug_subnhex(0, "shadow", record.shadow, msg);
             }
@@ -180,6 +184,7 @@ control_register::dump_log()
 
             for (const auto &record : m_cr3_log) {
                 bfdebug_info(0, "record", msg);
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
                 bfdebug_subnhex(0, "val", record.val, msg);
                 bfdebug_subnhex(0, "shadow", record.shadow, msg);
             }
@@ -196,6 +201,7 @@ control_register::dump_log()
 
             for (const auto &record : m_cr4_log) {
                 bfdebug_info(0, "record", msg);
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
                 bfdebug_subnhex(0, "val", record.val, msg);
                 bfdebug_subnhex(0, "shadow", record.shadow, msg);
             }
@@ -212,6 +218,7 @@ control_register::dump_log()
 
             for (const auto &record : m_cr8_log) {
                 bfdebug_info(0, "record", msg);
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
                 bfdebug_subnhex(0, "val", record.val, msg);
                 bfdebug_subnhex(0, "shadow", record.shadow, msg);
             }
@@ -228,9 +235,14 @@ control_register::dump_log()
 bool
 control_register::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::control_register_accesses};
+
     using namespace vmcs_n::exit_qualification::control_register_access;
 
-    switch (control_register_number::get()) {
+    const auto qual = m_exit_info->qualification();
+    timer.trace(qual, control_register_number::get(qual));
+
+    switch (control_register_number::get(qual)) {
         case 0:
             return handle_wrcr0(vmcs);
 
@@ -253,7 +265,7 @@ control_register::handle_cr3(gsl::not_null<vmcs_t *> vmcs)
 {
     using namespace vmcs_n::exit_qualification::control_register_access;
 
-    switch (access_type::get()) {
+    switch (access_type::get(m_exit_info->qualification())) {
         case access_type::mov_from_cr:
             return handle_rdcr3(vmcs);
 
@@ -270,7 +282,7 @@ control_register::handle_cr8(gsl::not_null<vmcs_t *> vmcs)
 {
     using namespace vmcs_n::exit_qualification::control_register_access;
 
-    switch (access_type::get()) {
+    switch (access_type::get(m_exit_info->qualification())) {
         case access_type::mov_from_cr:
             return handle_rdcr8(vmcs);
 
@@ -24,14 +24,35 @@ namespace eapis
 namespace intel_x64
 {
 
+// Leaves whose hardware values depend on the state of the CPU executing
+// CPUID (control registers, XCR0, APIC ID) rather than on the leaf alone.
+
+static bool
+is_cacheable(cpuid::leaf_t leaf) noexcept
+{
+    switch (leaf) {
+        case 0x00000001:
+        case 0x0000000B:
+        case 0x0000000D:
+        case 0x0000001F:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
 cpuid::cpuid(gsl::not_null<eapis::intel_x64::hve *> hve) :
     m_exit_handler{hve->exit_handler()}
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::cpuid,
-        ::handler_delegate_t::create<cpuid, &cpuid::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<cpuid, &cpuid::handle>>(this)
     );
 }
 
@@ -48,7 +69,26 @@ cpuid::~cpuid()
 
 void cpuid::add_handler(
     leaf_t leaf, subleaf_t subleaf, handler_delegate_t &&d)
-{ m_handlers[ {leaf, subleaf}].push_front(d); }
+{
+    m_handlers[ {leaf, subleaf}].push_front(d);
+    m_cache.clear();
+}
+
+void cpuid::add_handler(
+    leaf_t leaf, handler_delegate_t &&d)
+{
+    m_leaf_handlers[leaf].push_front(d);
+    m_cache.clear();
+}
+
+void cpuid::enable_cache()
+{ m_cache_enabled = true; }
+
+void cpuid::disable_cache()
+{
+    m_cache_enabled = false;
+    m_cache.clear();
+}
 
 // -----------------------------------------------------------------------------
 // Debug
@@ -64,6 +104,7 @@ cpuid::dump_log()
 
         for (const auto &record : m_log) {
             bfdebug_info(0, "record", msg);
+            bfdebug_subnhex(0, "tsc", record.tsc, msg);
             bfdebug_subnhex(0, "leaf", record.leaf, msg);
             bfdebug_subnhex(0, "subleaf", record.subleaf, msg);
             bfdebug_subnhex(0, "rax", record.rax, msg);
@@ -83,11 +124,30 @@ cpuid::dump_log()
 bool
 cpuid::handle(gsl::not_null<vmcs_t *> vmcs)
 {
-    const auto &hdlrs = m_handlers.find({
-        vmcs->save_state()->rax, vmcs->save_state()->rcx
-    });
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::cpuid};
+
+    const auto leaf = vmcs->save_state()->rax;
+    const auto subleaf = vmcs->save_state()->rcx;
+
+    timer.trace(0, leaf, subleaf);
+
+    if (m_cache_enabled) {
+        const auto &cached = m_cache.find({leaf, subleaf});
+
+        if (cached != m_cache.end()) {
+            vmcs->save_state()->rax = set_bits(vmcs->save_state()->rax, 0x00000000FFFFFFFFULL, cached->second.rax);
+            vmcs->save_state()->rbx = set_bits(vmcs->save_state()->rbx, 0x00000000FFFFFFFFULL, cached->second.rbx);
+            vmcs->save_state()->rcx = set_bits(vmcs->save_state()->rcx, 0x00000000FFFFFFFFULL, cached->second.rcx);
+            vmcs->save_state()->rdx = set_bits(vmcs->save_state()->rdx, 0x00000000FFFFFFFFULL, cached->second.rdx);
+
+            return advance(vmcs);
+        }
+    }
 
-    if (GSL_LIKELY(hdlrs != m_handlers.end())) {
+    const auto &hdlrs = m_handlers.find({leaf, subleaf});
+    const auto &leaf_hdlrs = m_leaf_handlers.find(leaf);
+
+    if (GSL_LIKELY(hdlrs != m_handlers.end() || leaf_hdlrs != m_leaf_handlers.end())) {
 
         auto ret =
             ::x64::cpuid::get(
@@ -103,33 +163,23 @@ cpuid::handle(gsl::not_null<vmcs_t *> vmcs)
             ret.rcx,
             ret.rdx,
             false,
+            false,
             false
         };
 
         if (!ndebug && m_log_enabled) {
             add_record(m_log, {
-                vmcs->save_state()->rax,
-                vmcs->save_state()->rcx,
+                leaf, subleaf,
                 info.rax, info.rbx, info.rcx, info.rdx
             });
         }
 
-        for (const auto &d : hdlrs->second) {
-            if (d(vmcs, info)) {
-
-                if (!info.ignore_write) {
-                    vmcs->save_state()->rax = set_bits(vmcs->save_state()->rax, 0x00000000FFFFFFFFULL, info.rax);
-                    vmcs->save_state()->rbx = set_bits(vmcs->save_state()->rbx, 0x00000000FFFFFFFFULL, info.rbx);
-                    vmcs->save_state()->rcx = set_bits(vmcs->save_state()->rcx, 0x00000000FFFFFFFFULL, info.rcx);
-                    vmcs->save_state()->rdx = set_bits(vmcs->save_state()->rdx, 0x00000000FFFFFFFFULL, info.rdx);
-                }
-
-                if (!info.ignore_advance) {
-                    return advance(vmcs);
-                }
+        if (hdlrs != m_handlers.end() && this->dispatch(vmcs, info, hdlrs->second)) {
+            return true;
+        }
 
-                return true;
-            }
+        if (leaf_hdlrs != m_leaf_handlers.end() && this->dispatch(vmcs, info, leaf_hdlrs->second)) {
+            return true;
         }
     }
 
@@ -145,5 +195,38 @@ cpuid::handle(gsl::not_null<vmcs_t *> vmcs)
     return advance(vmcs);
 }
 
+bool
+cpuid::dispatch(
+    gsl::not_null<vmcs_t *> vmcs, info_t &info, const std::list<handler_delegate_t> &hdlrs)
+{
+    const auto leaf = vmcs->save_state()->rax;
+    const auto subleaf = vmcs->save_state()->rcx;
+
+    for (const auto &d : hdlrs) {
+        if (d(vmcs, info)) {
+
+            if (!info.ignore_write) {
+                vmcs->save_state()->rax = set_bits(vmcs->save_state()->rax, 0x00000000FFFFFFFFULL, info.rax);
+                vmcs->save_state()->rbx = set_bits(vmcs->save_state()->rbx, 0x00000000FFFFFFFFULL, info.rbx);
+                vmcs->save_state()->rcx = set_bits(vmcs->save_state()->rcx, 0x00000000FFFFFFFFULL, info.rcx);
+                vmcs->save_state()->rdx = set_bits(vmcs->save_state()->rdx, 0x00000000FFFFFFFFULL, info.rdx);
+            }
+
+            if (!info.ignore_advance) {
+                if (m_cache_enabled && !info.ignore_write && !info.ignore_cache &&
+                    is_cacheable(leaf) && m_cache.size() < EAPIS_CPUID_CACHE_MAX) {
+                    m_cache[ {leaf, subleaf}] = {info.rax, info.rbx, info.rcx, info.rdx};
+                }
+
+                return advance(vmcs);
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
 }
 }
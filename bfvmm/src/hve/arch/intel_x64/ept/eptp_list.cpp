@@ -0,0 +1,82 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <bfvmm/memory_manager/memory_manager.h>
+#include <hve/arch/intel_x64/ept/eptp_list.h>
+#include <hve/arch/intel_x64/ept/helpers.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+namespace ept
+{
+
+eptp_list::eptp_list() :
+    m_list{std::make_unique<uint64_t[]>(num_entries)}
+{ }
+
+void
+eptp_list::set(uint64_t index, memory_map &mem_map)
+{
+    expects(index < num_entries);
+    m_list[index] = ept::eptp(mem_map);
+}
+
+void
+eptp_list::clear(uint64_t index)
+{
+    expects(index < num_entries);
+    m_list[index] = 0;
+}
+
+uint64_t
+eptp_list::eptp(uint64_t index) const
+{
+    expects(index < num_entries);
+    return m_list[index];
+}
+
+hpa_t
+eptp_list::hpa() const noexcept
+{ return g_mm->virtptr_to_physint(m_list.get()); }
+
+void
+eptp_list::enable()
+{
+    using namespace vmcs_n;
+
+    eptp_list_address::set(this->hpa());
+
+    vm_function_controls::eptp_switching::enable();
+    secondary_processor_based_vm_execution_controls::enable_vm_functions::enable();
+}
+
+void
+eptp_list::switch_to(uint64_t index)
+{
+    expects(index < num_entries);
+    expects(m_list[index] != 0);
+
+    vmcs_n::ept_pointer::set(m_list[index]);
+    vmcs_n::eptp_index::set(index);
+}
+
+}
+}
+}
@@ -17,6 +17,8 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <algorithm>
+
 #include <intrinsics.h>
 #include "hve/arch/intel_x64/hve.h"
 #include "hve/arch/intel_x64/ept/helpers.h"
@@ -50,6 +52,13 @@ uintptr_t align_2m(uintptr_t addr)
 uintptr_t align_4k(uintptr_t addr)
 { return (addr & ~(ept::page_size_4k - 1U)); }
 
+// Returns the number of bytes covered by the 4KB pages spanning the
+// inclusive range [gpa_s, gpa_e]
+//
+static inline uint64_t
+range_len(gpa_t gpa_s, gpa_t gpa_e)
+{ return (((gpa_e - align_4k(gpa_s)) / page_size_4k) + 1ULL) * page_size_4k; }
+
 uint64_t
 eptp(memory_map &mem_map)
 {
@@ -58,7 +67,14 @@ eptp(memory_map &mem_map)
 
     eptp::memory_type::set(val, eptp::memory_type::write_back);
     eptp::page_walk_length_minus_one::set(val, max_page_walk_length - 1U);
-    eptp::accessed_and_dirty_flags::disable(val);
+
+    if (mem_map.accessed_dirty_enabled()) {
+        eptp::accessed_and_dirty_flags::enable(val);
+    }
+    else {
+        eptp::accessed_and_dirty_flags::disable(val);
+    }
+
     eptp::phys_addr::set(val, pml4_hpa);
 
     return val;
@@ -92,9 +108,9 @@ map_1g(memory_map &mem_map, gpa_t gpa, hpa_t hpa, memory_attr_t mattr)
 void
 map_n_contig_1g(memory_map &mem_map, gpa_t gpa, hpa_t hpa, uint64_t n, memory_attr_t mattr)
 {
-    for (auto i = 0ULL; i < n; i++) {
-        map_1g(mem_map, gpa + (i * page_size_1g), hpa + (i * page_size_1g), mattr);
-    }
+    mem_map.map_range(
+        align_1g(gpa), hpa, n * page_size_1g, mattr, page_size_1g, page_size_1g
+    );
 }
 
 void
@@ -112,11 +128,7 @@ identity_map_1g(memory_map &mem_map, gpa_t gpa, memory_attr_t mattr)
 
 void
 identity_map_n_contig_1g(memory_map &mem_map, gpa_t gpa, uint64_t n, memory_attr_t mattr)
-{
-    for (auto i = 0ULL; i < n; i++) {
-        identity_map_1g(mem_map, gpa + (i * page_size_1g), mattr);
-    }
-}
+{ map_n_contig_1g(mem_map, gpa, align_1g(gpa), n, mattr); }
 
 void
 identity_map_range_1g(memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, memory_attr_t mattr)
@@ -141,9 +153,9 @@ map_2m(memory_map &mem_map, gpa_t gpa, hpa_t hpa, memory_attr_t mattr)
 void
 map_n_contig_2m(memory_map &mem_map, gpa_t gpa, hpa_t hpa, uint64_t n, memory_attr_t mattr)
 {
-    for (auto i = 0ULL; i < n; i++) {
-        map_2m(mem_map, gpa + (i * page_size_2m), hpa + (i * page_size_2m), mattr);
-    }
+    mem_map.map_range(
+        align_2m(gpa), hpa, n * page_size_2m, mattr, page_size_2m, page_size_2m
+    );
 }
 
 void
@@ -161,11 +173,7 @@ identity_map_2m(memory_map &mem_map, gpa_t gpa, memory_attr_t mattr)
 
 void
 identity_map_n_contig_2m(memory_map &mem_map, gpa_t gpa, uint64_t n, memory_attr_t mattr)
-{
-    for (auto i = 0ULL; i < n; i++) {
-        identity_map_2m(mem_map, gpa + (i * page_size_2m), mattr);
-    }
-}
+{ map_n_contig_2m(mem_map, gpa, align_2m(gpa), n, mattr); }
 
 void
 identity_map_range_2m(memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, memory_attr_t mattr)
@@ -190,9 +198,9 @@ map_4k(memory_map &mem_map, gpa_t gpa, hpa_t hpa, memory_attr_t mattr)
 void
 map_n_contig_4k(memory_map &mem_map, gpa_t gpa, hpa_t hpa, uint64_t n, memory_attr_t mattr)
 {
-    for (auto i = 0ULL; i < n; i++) {
-        map_4k(mem_map, gpa + (i * page_size_4k), hpa + (i * page_size_4k), mattr);
-    }
+    mem_map.map_range(
+        align_4k(gpa), hpa, n * page_size_4k, mattr, page_size_4k, page_size_4k
+    );
 }
 
 void
@@ -210,11 +218,7 @@ identity_map_4k(memory_map &mem_map, gpa_t gpa, memory_attr_t mattr)
 
 void
 identity_map_n_contig_4k(memory_map &mem_map, gpa_t gpa, uint64_t n, memory_attr_t mattr)
-{
-    for (auto i = 0ULL; i < n; i++) {
-        identity_map_4k(mem_map, gpa + (i * page_size_4k), mattr);
-    }
-}
+{ map_n_contig_4k(mem_map, gpa, align_4k(gpa), n, mattr); }
 
 void
 identity_map_range_4k(memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, memory_attr_t mattr)
@@ -236,23 +240,9 @@ identity_map_bestfit_lo(ept::memory_map &mem_map, uintptr_t gpa_s, uintptr_t gpa
     expects(gpa_s == align_1g(gpa_s));
     expects(gpa_s < align_4k(gpa_e));
 
-    const auto end_1g = align_1g(gpa_e);
-    const auto end_2m = align_2m(gpa_e);
-    const auto end_4k = align_4k(gpa_e);
-
-    auto i = gpa_s;
-
-    for (; i < end_1g; i += ept::page_size_1g) {
-        ept::identity_map_1g(mem_map, i, mattr);
-    }
-
-    for (; i < end_2m; i += ept::page_size_2m) {
-        ept::identity_map_2m(mem_map, i, mattr);
-    }
-
-    for (; i <= end_4k; i += ept::page_size_4k) {
-        ept::identity_map_4k(mem_map, i, mattr);
-    }
+    mem_map.map_range(
+        gpa_s, gpa_s, range_len(gpa_s, gpa_e), mattr, page_size_4k, page_size_1g
+    );
 }
 
 void
@@ -262,125 +252,44 @@ identity_map_bestfit_hi(ept::memory_map &mem_map, uintptr_t gpa_s, uintptr_t gpa
     expects(align_4k(gpa_s) == gpa_s);
     expects(align_1g(gpa_e) == gpa_e);
 
-    const auto end_4k = align_2m(gpa_s) + ept::page_size_2m;
-    const auto end_2m = align_1g(gpa_s) + ept::page_size_1g;
-    const auto end_1g = gpa_e;
-
-    auto i = gpa_s;
-
-    for (; i < end_4k; i += ept::page_size_4k) {
-        ept::identity_map_4k(mem_map, i, mattr);
-    }
-
-    for (; i < end_2m; i += ept::page_size_2m) {
-        ept::identity_map_2m(mem_map, i, mattr);
-    }
-
-    for (; i <= end_1g; i += ept::page_size_1g) {
-        ept::identity_map_1g(mem_map, i, mattr);
-    }
+    mem_map.map_range(
+        gpa_s, gpa_s, range_len(gpa_s, gpa_e + page_size_1g - 1U), mattr,
+        page_size_4k, page_size_1g
+    );
 }
 
 void
 map_bestfit_2m(ept::memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, hpa_t hpa,
                memory_attr_t mattr)
 {
-    // If the whole range < 2MB, map all at a smaller granularity
-    if (gpa_e - gpa_s < ept::page_size_2m - 1) {
-        ept::map_range_4k(mem_map, gpa_s, gpa_e, hpa, mattr);
-        return;
-    }
-
-    auto current_gpa = gpa_s;
-    auto current_hpa = hpa;
-
-    // Map the region starting at gpa_s that is not aligned to 2MB
-    if (align_2m(current_gpa) != current_gpa) {
-        const auto next_2m = align_2m(current_gpa) + ept::page_size_2m;
-        const auto offset = next_2m - current_gpa;
-
-        ept::map_range_4k(mem_map, current_gpa, next_2m - 1, current_hpa, mattr);
-        current_gpa += offset;
-        current_hpa += offset;
-    }
-
-    // Map the "middle" 2MB aligned page(s)
-    if (gpa_e - current_gpa >= ept::page_size_2m - 1) {
-        auto last_2m = align_2m(gpa_e);
-        if (align_2m(current_gpa) < last_2m && gpa_e - last_2m < ept::page_size_2m - 1) {
-            last_2m -= ept::page_size_2m;
-        }
-
-        ept::map_range_2m(mem_map, current_gpa, last_2m, current_hpa, mattr);
-
-        const auto offset = (last_2m - current_gpa) + ept::page_size_2m;
-        current_gpa += offset;
-        current_hpa += offset;
-    }
+    expects(gpa_s <= gpa_e);
 
-    // Map the "tail" region smaller than 2MB
-    if (current_gpa < gpa_e) {
-        ept::map_range_4k(mem_map, current_gpa, gpa_e, current_hpa, mattr);
-    }
+    mem_map.map_range(
+        align_4k(gpa_s), hpa, range_len(gpa_s, gpa_e), mattr, page_size_4k, page_size_2m
+    );
 }
 
 void
 map_bestfit_1g(ept::memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, hpa_t hpa,
                memory_attr_t mattr)
 {
-    // If the whole range < 1G, map all at a smaller granularity
-    if (gpa_e - gpa_s < ept::page_size_1g - 1) {
-        ept::map_bestfit_2m(mem_map, gpa_s, gpa_e, hpa, mattr);
-        return;
-    }
-
-    auto current_gpa = gpa_s;
-    auto current_hpa = hpa;
-
-    // Map the region starting at gpa_s that is not aligned to 1GB
-    if (align_1g(current_gpa) != current_gpa) {
-        const auto next_1g = align_1g(current_gpa) + ept::page_size_1g;
-        const auto offset = next_1g - current_gpa;
-
-        ept::map_bestfit_2m(mem_map, current_gpa, next_1g - 1, current_hpa, mattr);
-        current_gpa += offset;
-        current_hpa += offset;
-    }
-
-    // Map the "middle" 1GB aligned page(s)
-    if (gpa_e - current_gpa >= ept::page_size_1g - 1) {
-        auto last_1g = align_1g(gpa_e);
-        if (align_1g(current_gpa) < last_1g && gpa_e - last_1g < ept::page_size_1g - 1) {
-            last_1g -= ept::page_size_1g;
-        }
-
-        ept::map_range_1g(mem_map, current_gpa, last_1g, current_hpa, mattr);
-
-        const auto offset = (last_1g - current_gpa) + ept::page_size_1g;
-        current_gpa += offset;
-        current_hpa += offset;
-    }
+    expects(gpa_s <= gpa_e);
 
-    // Map the "tail" region smaller than 1GB
-    if (current_gpa < gpa_e) {
-        ept::map_bestfit_2m(mem_map, current_gpa, gpa_e, current_hpa, mattr);
-    }
+    mem_map.map_range(
+        align_4k(gpa_s), hpa, range_len(gpa_s, gpa_e), mattr, page_size_4k, page_size_1g
+    );
 }
 
 void
 map_bestfit(ept::memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e, hpa_t hpa,
             memory_attr_t mattr)
 {
-    switch (mem_map.max_page_size()) {
-        case ept::page_size_1g:
-            map_bestfit_1g(mem_map, gpa_s, gpa_e, hpa, mattr);
-            break;
-        case ept::page_size_2m:
-            map_bestfit_2m(mem_map, gpa_s, gpa_e, hpa, mattr);
-            break;
-        default:
-            ept::map_range_4k(mem_map, gpa_s, gpa_e, hpa, mattr);
-    }
+    expects(gpa_s <= gpa_e);
+
+    mem_map.map_range(
+        align_4k(gpa_s), hpa, range_len(gpa_s, gpa_e), mattr,
+        page_size_4k, mem_map.max_page_size()
+    );
 }
 
 //--------------------------------------------------------------------------
@@ -454,6 +363,74 @@ void
 identity_map(memory_map &mem_map, gpa_t gpa_s, gpa_t gpa_e)
 { map(mem_map, gpa_s, gpa_e, gpa_s); }
 
+static bool
+is_guest_accessible(const host_memory_region &desc)
+{
+    switch (desc.type) {
+        case host_memory_type::ram:
+        case host_memory_type::acpi_reclaimable:
+        case host_memory_type::acpi_nvs:
+        case host_memory_type::mmio:
+            return desc.size != 0;
+
+        default:
+            return false;
+    }
+}
+
+std::vector<host_memory_region>
+coalesce(std::vector<host_memory_region> descriptors)
+{
+    const auto last = std::remove_if(
+        descriptors.begin(), descriptors.end(),
+        [](const host_memory_region & desc) { return !is_guest_accessible(desc); }
+    );
+
+    descriptors.erase(last, descriptors.end());
+
+    std::sort(descriptors.begin(), descriptors.end(),
+    [](const host_memory_region & lhs, const host_memory_region & rhs) {
+        return lhs.base < rhs.base;
+    });
+
+    std::vector<host_memory_region> runs;
+
+    for (const auto &desc : descriptors) {
+        auto desc_s = align_4k(desc.base);
+        const auto desc_e = align_4k(desc.base + (desc.size - 1U)) + page_size_4k;
+
+        if (!runs.empty()) {
+            auto &run = runs.back();
+            const auto run_e = run.base + run.size;
+
+            if (desc_s <= run_e && desc.type == run.type) {
+                run.size = std::max(run_e, desc_e) - run.base;
+                continue;
+            }
+
+            // The runs are sorted and do not overlap, so the part of a
+            // region that an earlier run already covers is dropped.
+
+            desc_s = std::max(desc_s, run_e);
+            if (desc_s >= desc_e) {
+                continue;
+            }
+        }
+
+        runs.push_back({desc_s, desc_e - desc_s, desc.type});
+    }
+
+    return runs;
+}
+
+void
+identity_map(memory_map &mem_map, std::vector<host_memory_region> descriptors)
+{
+    for (const auto &run : coalesce(std::move(descriptors))) {
+        identity_map(mem_map, run.base, run.base + run.size - page_size_4k);
+    }
+}
+
 //--------------------------------------------------------------------------
 // Unmapping
 //--------------------------------------------------------------------------
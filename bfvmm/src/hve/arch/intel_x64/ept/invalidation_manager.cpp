@@ -0,0 +1,98 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <hve/arch/intel_x64/ept/helpers.h>
+#include <hve/arch/intel_x64/ept/invalidation_manager.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+namespace ept
+{
+
+invalidation_manager::invalidation_manager(memory_map &mem_map) :
+    m_mem_map{mem_map},
+    m_generation{mem_map.generation()}
+{ }
+
+void
+invalidation_manager::invalidate_gva(uint64_t gva)
+{
+    m_requested++;
+    m_gvas.push_back(gva);
+}
+
+bool
+invalidation_manager::pending() const noexcept
+{ return m_generation != m_mem_map.generation() || !m_gvas.empty(); }
+
+void
+invalidation_manager::flush()
+{
+    const auto generation = m_mem_map.generation();
+
+    // A single-context INVEPT invalidates the combined mappings of every
+    // VPID as well, so queued GVAs do not need an INVVPID of their own.
+
+    if (generation != m_generation) {
+        m_requested += generation - m_generation;
+        m_generation = generation;
+
+        ::intel_x64::vmx::invept_single_context(ept::eptp(m_mem_map));
+        m_issued++;
+
+        m_gvas.clear();
+        return;
+    }
+
+    if (m_gvas.empty()) {
+        return;
+    }
+
+    const auto vpid = vmcs_n::virtual_processor_identifier::get();
+
+    if (m_gvas.size() > EAPIS_INVVPID_MAX_ADDRESSES) {
+        ::intel_x64::vmx::invvpid_single_context(vpid);
+        m_issued++;
+    }
+    else {
+        for (const auto &gva : m_gvas) {
+            ::intel_x64::vmx::invvpid_individual_address(vpid, gva);
+            m_issued++;
+        }
+    }
+
+    m_gvas.clear();
+}
+
+uint64_t
+invalidation_manager::requested() const noexcept
+{ return m_requested; }
+
+uint64_t
+invalidation_manager::issued() const noexcept
+{ return m_issued; }
+
+uint64_t
+invalidation_manager::saved() const noexcept
+{ return m_requested - m_issued; }
+
+}
+}
+}
@@ -0,0 +1,117 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <algorithm>
+#include <mutex>
+
+#include <hve/arch/intel_x64/hve.h>
+#include <hve/arch/intel_x64/ept/helpers.h>
+#include <hve/arch/intel_x64/ept/lazy_map.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+namespace ept
+{
+
+static std::mutex g_lazy_map_mutex;
+
+lazy_map::lazy_map(
+    gsl::not_null<eapis::intel_x64::hve *> hve,
+    memory_map &mem_map,
+    gpa_t gpa_s,
+    gpa_t gpa_e,
+    uint64_t region_size
+) :
+    m_mem_map{mem_map},
+    m_gpa_s{align_4k(gpa_s)},
+    m_gpa_e{align_4k(gpa_e)},
+    m_region_size{region_size}
+{
+    expects(gpa_s <= gpa_e);
+    expects(
+        region_size == page_size_4k ||
+        region_size == page_size_2m ||
+        region_size == page_size_1g
+    );
+
+    hve->add_ept_read_violation_handler(
+        ept_violation::handler_delegate_t::create<lazy_map, &lazy_map::handle>(this)
+    );
+
+    hve->add_ept_write_violation_handler(
+        ept_violation::handler_delegate_t::create<lazy_map, &lazy_map::handle>(this)
+    );
+
+    hve->add_ept_execute_violation_handler(
+        ept_violation::handler_delegate_t::create<lazy_map, &lazy_map::handle>(this)
+    );
+}
+
+uint64_t
+lazy_map::faulted_regions() const noexcept
+{ return m_faulted_regions; }
+
+bool
+lazy_map::handle(gsl::not_null<vmcs_t *> vmcs, ept_violation::info_t &info)
+{
+    bfignored(vmcs);
+    using namespace vmcs_n::exit_qualification::ept_violation;
+
+    // Only violations on non-present entries are ours. Anything else is a
+    // permission violation on a page someone has already mapped.
+
+    const auto qual = info.exit_qualification;
+    if (readable::is_enabled(qual) || writeable::is_enabled(qual) || executable::is_enabled(qual)) {
+        return false;
+    }
+
+    const auto gpa = align_4k(info.gpa);
+    if (gpa < m_gpa_s || gpa > m_gpa_e) {
+        return false;
+    }
+
+    info.ignore_advance = true;
+    std::lock_guard<std::mutex> lock(g_lazy_map_mutex);
+
+    // Another vCPU sharing this memory map may have populated the region
+    // while we were waiting on the lock, in which case the access only
+    // needs to be retried.
+
+    const auto unmapped = m_mem_map.unmapped_size(gpa);
+    if (unmapped == 0) {
+        return true;
+    }
+
+    const auto size = std::min(unmapped, m_region_size);
+    const auto base = gpa & ~(size - 1U);
+
+    ept::identity_map(
+        m_mem_map,
+        std::max(base, m_gpa_s),
+        std::min(base + (size - page_size_4k), m_gpa_e)
+    );
+
+    m_faulted_regions++;
+    return true;
+}
+
+}
+}
+}
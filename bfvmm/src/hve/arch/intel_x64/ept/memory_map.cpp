@@ -25,16 +25,12 @@
 //     impractical.
 //
 
-// FIXME
-// TIDY_EXCLUSION=-cppcoreguidelines-owning-memory
-//
-// Reason:
-//     This triggers during the allocation which is part of the test harness
-//     so this can be safely ignored.
-//
+#include <algorithm>
 
 #include <arch/intel_x64/msrs.h>
+#include <arch/intel_x64/vmx.h>
 #include <bfvmm/memory_manager/memory_manager.h>
+#include "hve/arch/intel_x64/ept/helpers.h"
 #include "hve/arch/intel_x64/ept/memory_map.h"
 #include "hve/arch/intel_x64/ept/intrinsics.h"
 #include "hve/arch/intel_x64/phys_mtrr.h"
@@ -46,11 +42,38 @@ namespace intel_x64
 namespace ept
 {
 
+static_assert((EAPIS_EPT_CACHE_SIZE & (EAPIS_EPT_CACHE_SIZE - 1)) == 0,
+              "EAPIS_EPT_CACHE_SIZE must be a power of two");
+
+static const std::array<uint64_t, 3> s_leaf_sizes = {
+    page_size_4k, page_size_2m, page_size_1g
+};
+
+static inline uint64_t
+level_page_size(uint64_t level)
+{ return page_size_4k << ((level - 1U) * 9U); }
+
+static inline uint64_t
+level_index(gpa_t gpa, uint64_t level)
+{ return (gpa / level_page_size(level)) & (page_table::num_entries - 1U); }
+
+static inline bool
+is_aligned(uintptr_t addr, uint64_t size)
+{ return (addr & (size - 1U)) == 0; }
+
+static inline uint64_t
+cache_index(gpa_t gpa, uint64_t size)
+{ return ((gpa / size) + (size / page_size_2m)) & (EAPIS_EPT_CACHE_SIZE - 1U); }
+
 memory_map::memory_map()
 {
-    auto pml4 = new epte_t[page_table::num_entries]();
-    m_pml4_hva = reinterpret_cast<hva_t>(pml4);
-    m_pml4_hpa = g_mm->virtint_to_physint(m_pml4_hva);
+    this->allocate_slab();
+
+    auto pml4 = m_free_tables.back();
+    m_free_tables.pop_back();
+
+    m_pml4_hva = pml4.hva;
+    m_pml4_hpa = pml4.hpa;
 
     m_cap = ::intel_x64::msrs::ia32_vmx_ept_vpid_cap::get();
     m_max_page_size = ept::page_size_4k;
@@ -62,39 +85,127 @@ memory_map::memory_map()
     }
 }
 
-memory_map::~memory_map()
+memory_map::memory_map(gsl::not_null<const memory_map *> base) :
+    memory_map()
 {
-    auto pml4 = reinterpret_cast<epte_t *>(m_pml4_hva);
-    auto pml4_view = gsl::make_span(pml4, page_table::num_entries);
+    std::lock_guard<std::mutex> lock(base->m_mutex);
 
-    for (auto pml4e : pml4_view) {
-        if (epte::is_present(pml4e) && !epte::is_leaf_entry(pml4e)) {
-            free_page_table(pml4e);
-        }
-        epte::clear(pml4e);
-    }
+    auto base_pml4 = reinterpret_cast<const epte_t *>(g_mm->physint_to_virtint(base->m_pml4_hpa));
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
 
-    delete[] pml4;
+    std::copy(base_pml4, base_pml4 + page_table::num_entries, pml4);
+
+    m_accessed_dirty = base->m_accessed_dirty;
+    m_empty_entry = base->m_empty_entry;
 }
 
+memory_map::~memory_map() = default;
+
 uint64_t
 memory_map::max_page_size() const
 { return m_max_page_size; }
 
+void
+memory_map::enable_accessed_dirty()
+{
+    if (!::intel_x64::msrs::ia32_vmx_ept_vpid_cap::accessed_dirty_support::is_enabled(m_cap)) {
+        throw std::runtime_error("enable_accessed_dirty: EPT accessed and "
+                                 "dirty flags are not supported");
+    }
+
+    m_accessed_dirty = true;
+}
+
+bool
+memory_map::accessed_dirty_enabled() const
+{ return m_accessed_dirty; }
+
+void
+memory_map::enable_suppress_ve()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_empty_entry != 0) {
+        return;
+    }
+
+    epte::suppress_ve::enable(m_empty_entry);
+
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+    this->set_suppress_ve(pml4);
+
+    this->clear_cache();
+    m_generation++;
+}
+
+bool
+memory_map::suppress_ve_enabled() const
+{ return m_empty_entry != 0; }
+
+void
+memory_map::set_suppress_ve(gpa_t gpa, uint64_t len, bool suppress)
+{
+    expects(is_aligned(gpa, page_size_4k));
+    expects(is_aligned(len, page_size_4k));
+    expects(len != 0);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+    this->set_suppress_ve(pml4, pml4e::page_table_level, gpa, gpa + len, suppress);
+
+    m_generation++;
+}
+
+std::vector<uint64_t>
+memory_map::harvest_accessed(gpa_t gpa, uint64_t len)
+{ return this->harvest(gpa, len, epte::accessed_flag::mask); }
+
+std::vector<uint64_t>
+memory_map::harvest_dirty(gpa_t gpa, uint64_t len)
+{ return this->harvest(gpa, len, epte::dirty::mask); }
+
+void
+memory_map::clear_dirty(const std::vector<gpa_t> &pages)
+{
+    if (pages.empty()) {
+        return;
+    }
+
+    std::vector<uint64_t> bitmap(1, 0);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+
+    for (const auto &page : pages) {
+        const auto gpa = page & ~(page_size_4k - 1U);
+        this->harvest(pml4, pml4e::page_table_level, gpa, gpa, gpa + page_size_4k, epte::dirty::mask, bitmap);
+    }
+
+    m_generation++;
+
+    ::intel_x64::vmx::invept_single_context(ept::eptp(*this));
+}
+
 epte_t &
 memory_map::map(gpa_t gpa, hpa_t hpa, uint64_t size)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
     switch (size) {
         case pdpte::page_size_bytes:
             expects(pdpte::page_address::is_aligned(hpa));
+            this->clear_cache(gpa, size);
             return this->map_pdpte_to_page(gpa, hpa);
 
         case pde::page_size_bytes:
             expects(pde::page_address::is_aligned(hpa));
+            this->clear_cache(gpa, size);
             return this->map_pde_to_page(gpa, hpa);
 
         case pte::page_size_bytes:
             expects(pte::page_address::is_aligned(hpa));
+            this->clear_cache(gpa, size);
             return this->map_pte_to_page(gpa, hpa);
 
         default:
@@ -102,15 +213,316 @@ memory_map::map(gpa_t gpa, hpa_t hpa, uint64_t size)
     }
 }
 
+void
+memory_map::map_range(gpa_t gpa, hpa_t hpa, uint64_t len, memory_attr_t attr)
+{ this->map_range(gpa, hpa, len, attr, page_size_4k, m_max_page_size); }
+
+void
+memory_map::map_range(
+    gpa_t gpa, hpa_t hpa, uint64_t len, memory_attr_t attr,
+    uint64_t min_size, uint64_t max_size)
+{
+    expects(min_size == page_size_4k || min_size == page_size_2m || min_size == page_size_1g);
+    expects(min_size <= max_size);
+    expects(is_aligned(gpa, min_size));
+    expects(is_aligned(hpa, min_size));
+    expects(is_aligned(len, min_size));
+    expects(len != 0);
+
+    epte_t leaf = 0;
+    epte::entry_type::enable(leaf);
+    epte::memory_attr::set(leaf, attr);
+    leaf |= m_empty_entry;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+    this->map_range(pml4, pml4e::page_table_level, gpa, hpa, gpa + len, leaf, min_size, max_size);
+    this->clear_cache();
+}
+
 void
 memory_map::unmap(gpa_t gpa)
 {
-    auto &leaf = gpa_to_epte(gpa);
-    epte::clear(leaf);
+    uint64_t size = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto &leaf = this->private_leaf(gpa, size);
+
+    this->clear_cache(gpa, size);
+    this->clear_entry(leaf);
+
+    m_generation++;
+}
+
+uint64_t
+memory_map::unmap_range(gpa_t gpa, uint64_t len)
+{
+    expects(is_aligned(gpa, page_size_4k));
+    expects(is_aligned(len, page_size_4k));
+    expects(len != 0);
+
+    uint64_t reclaimed = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+
+    this->unmap_range(pml4, pml4e::page_table_level, gpa, gpa + len, reclaimed);
+    this->clear_cache();
+    m_generation++;
+
+    return reclaimed;
+}
+
+uint64_t
+memory_map::unmapped_size(gpa_t gpa)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto table = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+
+    for (auto level = pml4e::page_table_level; level > 0; level--) {
+        auto &entry = table[level_index(gpa, level)];
+
+        if (!epte::is_present(entry)) {
+            return level_page_size(level);
+        }
+
+        if (epte::is_leaf_entry(entry) || level == pte::page_table_level) {
+            break;
+        }
+
+        table = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(epte::hpa(entry)));
+    }
+
+    return 0;
+}
+
+epte_t &
+memory_map::split(gpa_t gpa, uint64_t target_size)
+{
+    expects(target_size == page_size_4k || target_size == page_size_2m);
+
+    uint64_t size = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto entry = &this->private_leaf(gpa, size);
+
+    if (size <= target_size) {
+        return *entry;
+    }
+
+    while (size > target_size) {
+        auto child = this->split_leaf(*entry, size);
+
+        size /= page_table::num_entries;
+        entry = &child[(gpa / size) & (page_table::num_entries - 1U)];
+    }
+
+    this->clear_cache();
+    m_generation++;
+
+    return *entry;
+}
+
+epte_t &
+memory_map::unshare(gpa_t gpa, uint64_t size)
+{
+    expects(size == page_size_4k || size == page_size_2m || size == page_size_1g);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto level = pml4e::page_table_level;
+    auto table = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+
+    while (true) {
+        auto &entry = table[level_index(gpa, level)];
+        const auto entry_size = level_page_size(level);
+
+        if (!epte::is_present(entry)) {
+            throw std::runtime_error("unshare: gpa is not mapped");
+        }
+
+        if (entry_size == size) {
+            if (!epte::is_leaf_entry(entry)) {
+                throw std::runtime_error("unshare: gpa is mapped with pages "
+                                         "smaller than " + std::to_string(size >> 12U) +
+                                         "KB");
+            }
+
+            this->clear_cache();
+            m_generation++;
+
+            return entry;
+        }
+
+        if (epte::is_leaf_entry(entry)) {
+            table = this->split_leaf(entry, entry_size);
+        }
+        else {
+            table = this->unshare_table(entry);
+        }
+
+        level--;
+    }
+}
+
+bool
+memory_map::try_merge(gpa_t gpa)
+{
+    std::array<epte_t *, pml4e::page_table_level + 1U> entries{};
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto level = pml4e::page_table_level;
+    auto table = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+
+    while (true) {
+        auto &entry = table[level_index(gpa, level)];
+        entries.at(level) = &entry;
+
+        if (!epte::is_present(entry)) {
+            throw std::runtime_error("try_merge: gpa is not mapped");
+        }
+
+        if (epte::is_leaf_entry(entry) || level == pte::page_table_level) {
+            break;
+        }
+
+        table = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(epte::hpa(entry)));
+        level--;
+    }
+
+    auto merged = false;
+
+    for (level++; level < pml4e::page_table_level; level++) {
+        if (!this->merge_table(*entries.at(level), level_page_size(level))) {
+            break;
+        }
+
+        merged = true;
+    }
+
+    if (merged) {
+        this->clear_cache();
+        m_generation++;
+    }
+
+    return merged;
 }
 
 epte_t &
 memory_map::gpa_to_epte(gpa_t gpa)
+{
+    uint64_t size = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (auto entry = this->cache_lookup(gpa, size)) {
+        return *entry;
+    }
+
+    return this->gpa_to_leaf(gpa, size);
+}
+
+hpa_t
+memory_map::gpa_to_hpa(gpa_t gpa)
+{
+    uint64_t size = 0;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto entry = this->cache_lookup(gpa, size);
+
+    if (entry == nullptr) {
+        entry = &this->gpa_to_leaf(gpa, size);
+    }
+
+    return epte::hpa(*entry) | (gpa & (size - 1U));
+}
+
+void
+memory_map::invalidate_cache(gpa_t gpa, uint64_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    this->clear_cache(gpa, size);
+    m_generation++;
+}
+
+void
+memory_map::flush_cache()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    this->clear_cache();
+    m_generation++;
+}
+
+uint64_t
+memory_map::cache_hits() const
+{ return m_cache_hits.load(std::memory_order_relaxed); }
+
+uint64_t
+memory_map::cache_misses() const
+{ return m_cache_misses.load(std::memory_order_relaxed); }
+
+uint64_t
+memory_map::generation() const noexcept
+{ return m_generation; }
+
+std::vector<memory_descriptor>
+memory_map::to_mdl() const
+{
+    std::vector<memory_descriptor> mdl;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    mdl.push_back({m_pml4_hpa, m_pml4_hva, MEMORY_TYPE_R | MEMORY_TYPE_W});
+
+    this->to_mdl(mdl, reinterpret_cast<epte_t *>(m_pml4_hva));
+
+    return mdl;
+}
+
+hpa_t
+memory_map::hpa() const
+{ return m_pml4_hpa; }
+
+epte_t *
+memory_map::cache_lookup(gpa_t gpa, uint64_t &size)
+{
+    for (auto leaf_size : s_leaf_sizes) {
+        const auto &slot = m_cache.at(cache_index(gpa, leaf_size));
+
+        if (slot.size == leaf_size && slot.gpa == (gpa & ~(leaf_size - 1U))) {
+            if (GSL_LIKELY(epte::is_present(*slot.entry) && epte::is_leaf_entry(*slot.entry))) {
+                m_cache_hits.fetch_add(1, std::memory_order_relaxed);
+
+                size = leaf_size;
+                return slot.entry;
+            }
+        }
+    }
+
+    m_cache_misses.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void
+memory_map::cache_insert(gpa_t gpa, uint64_t size, epte_t &entry)
+{ m_cache.at(cache_index(gpa, size)) = {gpa & ~(size - 1U), size, &entry}; }
+
+void
+memory_map::clear_cache(gpa_t gpa, uint64_t size)
+{
+    auto &slot = m_cache.at(cache_index(gpa, size));
+
+    if (slot.size == size && slot.gpa == (gpa & ~(size - 1U))) {
+        slot = {0, 0, nullptr};
+    }
+}
+
+void
+memory_map::clear_cache()
+{ m_cache.fill({0, 0, nullptr}); }
+
+epte_t &
+memory_map::gpa_to_leaf(gpa_t gpa, uint64_t &size)
 {
     auto &pml4e = this->gpa_to_pml4e(gpa);
     if (!epte::is_present(pml4e)) {
@@ -124,6 +536,8 @@ memory_map::gpa_to_epte(gpa_t gpa)
                                  "gpa is not mapped at the 1GB level");
     }
     if (epte::is_leaf_entry(pdpte)) {
+        size = pdpte::page_size_bytes;
+        this->cache_insert(gpa, size, pdpte);
         return pdpte;
     }
 
@@ -133,6 +547,8 @@ memory_map::gpa_to_epte(gpa_t gpa)
                                  "gpa is not mapped at the 2MB level");
     }
     if (epte::is_leaf_entry(pde)) {
+        size = pde::page_size_bytes;
+        this->cache_insert(gpa, size, pde);
         return pde;
     }
 
@@ -142,73 +558,82 @@ memory_map::gpa_to_epte(gpa_t gpa)
                                  "gpa is not mapped at the 4KB level");
     }
     if (epte::is_leaf_entry(pte)) {
+        size = pte::page_size_bytes;
+        this->cache_insert(gpa, size, pte);
         return pte;
     }
 
     throw std::runtime_error("gpa_to_epte: extended page tables corrupted");
 }
 
-hpa_t
-memory_map::gpa_to_hpa(gpa_t gpa)
+void
+memory_map::allocate_slab()
 {
-    auto &pml4e = this->gpa_to_pml4e(gpa);
-    if (!epte::is_present(pml4e)) {
-        throw std::runtime_error("gpa_to_hpa: failed to resolve gpa->epte, gpa "
-                                 "is not mapped at the 512GB level");
-    }
+    constexpr const auto slab_size = static_cast<uint64_t>(EAPIS_EPT_SLAB_SIZE);
+    constexpr const auto slab_bytes = slab_size * page_table::size_bytes;
 
-    auto &pdpte = this->gpa_to_pdpte(gpa, pml4e);
-    if (!epte::is_present(pdpte)) {
-        throw std::runtime_error("gpa_to_hpa: failed to resolve gpa->epte, gpa "
-                                 "is not mapped at the 1GB level");
-    }
-    if (epte::is_leaf_entry(pdpte)) {
-        return pdpte::page_address::get_effective_address(pdpte, gpa);
-    }
+    // The allocator does not promise page alignment, so the slab is padded
+    // by a page and aligned by hand, the same way the exit trace ring is.
 
-    auto &pde = this->gpa_to_pde(gpa, pdpte);
-    if (!epte::is_present(pde)) {
-        throw std::runtime_error("gpa_to_hpa: failed to resolve gpa->epte, gpa "
-                                 "is not mapped at the 2MB level");
-    }
-    if (epte::is_leaf_entry(pde)) {
-        return pde::page_address::get_effective_address(pde, gpa);
-    }
+    auto size = static_cast<std::size_t>(slab_bytes + page_table::size_bytes);
+    auto buffer = std::make_unique<uint8_t[]>(size);
 
-    auto &pte = this->gpa_to_pte(gpa, pde);
-    if (!epte::is_present(pte)) {
-        throw std::runtime_error("gpa_to_hpa: failed to resolve gpa->epte, gpa "
-                                 "is not mapped at the 4KB level");
-    }
-    if (epte::is_leaf_entry(pte)) {
-        return pte::page_address::get_effective_address(pte, gpa);
+    void *slab = buffer.get();
+    ensures(std::align(page_table::size_bytes, slab_bytes, slab, size) != nullptr);
+
+    auto slab_hva = reinterpret_cast<hva_t>(slab);
+    auto slab_hpa = g_mm->virtint_to_physint(slab_hva);
+    ensures((slab_hpa & (page_table::size_bytes - 1U)) == 0);
+
+    // A slab is normally backed by physically contiguous memory, in which
+    // case each table's HPA is an offset from the slab's HPA. If the last
+    // table does not land where contiguity says it should, every table is
+    // translated on its own instead.
+
+    auto last_hva = slab_hva + (slab_bytes - page_table::size_bytes);
+    auto contiguous =
+        g_mm->virtint_to_physint(last_hva) == slab_hpa + (slab_bytes - page_table::size_bytes);
+
+    // Tables are pushed in reverse so that they are handed out in address
+    // order, which keeps neighboring tables close together in memory.
+
+    for (auto i = slab_size; i > 0U; i--) {
+        auto offset = (i - 1U) * page_table::size_bytes;
+        auto pt_hva = slab_hva + offset;
+        auto pt_hpa = contiguous ? slab_hpa + offset : g_mm->virtint_to_physint(pt_hva);
+
+        m_free_tables.push_back({pt_hva, pt_hpa});
+        m_owned_tables.insert(pt_hpa);
     }
 
-    throw std::runtime_error("gpa_to_hpa: extended page tables corrupted");
+    m_slabs.push_back(std::move(buffer));
 }
 
-std::vector<memory_descriptor>
-memory_map::to_mdl() const
+void
+memory_map::release_page_table(epte_t *page_table, hpa_t hpa)
 {
-    std::vector<memory_descriptor> mdl;
-    mdl.push_back({m_pml4_hpa, m_pml4_hva, MEMORY_TYPE_R | MEMORY_TYPE_W});
-
-    this->to_mdl(mdl, reinterpret_cast<epte_t *>(m_pml4_hva));
+    auto pt_view = gsl::make_span(page_table, page_table::num_entries);
+    std::fill(pt_view.begin(), pt_view.end(), 0U);
 
-    return mdl;
+    m_free_tables.push_back({reinterpret_cast<hva_t>(page_table), hpa});
 }
 
-hpa_t
-memory_map::hpa() const
-{ return m_pml4_hpa; }
-
 hpa_t
 memory_map::allocate_page_table()
 {
-    auto pt_hva = new epte_t [page_table::num_entries]();
-    auto pt_hpa = g_mm->virtptr_to_physint(pt_hva);
+    if (m_free_tables.empty()) {
+        this->allocate_slab();
+    }
 
-    return pt_hpa;
+    auto pt = m_free_tables.back();
+    m_free_tables.pop_back();
+
+    if (m_empty_entry != 0) {
+        auto pt_view = gsl::make_span(reinterpret_cast<epte_t *>(pt.hva), page_table::num_entries);
+        std::fill(pt_view.begin(), pt_view.end(), m_empty_entry);
+    }
+
+    return pt.hpa;
 }
 
 void
@@ -222,10 +647,21 @@ memory_map::allocate_page_table(epte_t &entry)
     epte::set_hpa(entry, pt_hpa);
 }
 
-void
+uint64_t
 memory_map::free_page_table(epte_t &entry)
 {
+    uint64_t freed = 1;
     auto pt_hpa = epte::hpa(entry);
+
+    // A table that is shared with the memory map this view was created
+    // from belongs to that memory map, so it is only unlinked.
+
+    if (!this->owns_page_table(pt_hpa)) {
+        this->clear_entry(entry);
+        this->clear_cache();
+
+        return 0;
+    }
     auto pt_hva = g_mm->physint_to_virtptr(pt_hpa);
     auto page_table = static_cast<epte_t *>(pt_hva);
 
@@ -233,14 +669,80 @@ memory_map::free_page_table(epte_t &entry)
 
     for (auto pte : pt_view) {
         if (epte::is_present(pte) && !epte::is_leaf_entry(pte)) {
-            this->free_page_table(pte);
+            freed += this->free_page_table(pte);
         }
     }
 
-    epte::clear(entry);
-    delete[] page_table;
+    this->clear_entry(entry);
+    this->release_page_table(page_table, pt_hpa);
+    this->clear_cache();
+
+    return freed;
+}
+
+epte_t *
+memory_map::copy_page_table(epte_t &entry)
+{
+    auto src = reinterpret_cast<const epte_t *>(g_mm->physint_to_virtint(epte::hpa(entry)));
+
+    auto table_entry = entry;
+    auto pt_hpa = this->allocate_page_table();
+    auto dst = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(pt_hpa));
+
+    std::copy(src, src + page_table::num_entries, dst);
+    epte::set_hpa(table_entry, pt_hpa);
+
+    // Cached entries may point into the table that was copied, which this
+    // memory map no longer uses.
+
+    entry = table_entry;
+    this->clear_cache();
+
+    return dst;
+}
+
+epte_t *
+memory_map::unshare_table(epte_t &entry)
+{
+    if (!this->owns_page_table(epte::hpa(entry))) {
+        return this->copy_page_table(entry);
+    }
+
+    return reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(epte::hpa(entry)));
+}
+
+epte_t &
+memory_map::private_leaf(gpa_t gpa, uint64_t &size)
+{
+    auto level = pml4e::page_table_level;
+    auto table = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+
+    while (true) {
+        auto &entry = table[level_index(gpa, level)];
+
+        if (!epte::is_present(entry)) {
+            throw std::runtime_error("gpa_to_epte: failed to resolve gpa->epte, "
+                                     "gpa is not mapped");
+        }
+
+        if (epte::is_leaf_entry(entry)) {
+            size = level_page_size(level);
+            return entry;
+        }
+
+        if (level == pte::page_table_level) {
+            throw std::runtime_error("gpa_to_epte: extended page tables corrupted");
+        }
+
+        table = this->unshare_table(entry);
+        level--;
+    }
 }
 
+bool
+memory_map::owns_page_table(hpa_t hpa) const
+{ return m_owned_tables.count(hpa) != 0; }
+
 void
 memory_map::map_entry_to_page_frame(epte_t &entry, hpa_t hpa)
 {
@@ -294,6 +796,299 @@ memory_map::gpa_to_pte(gpa_t gpa, epte_t &pde)
     return *reinterpret_cast<epte_t *>(pte_hva);
 }
 
+uint64_t
+memory_map::map_range(
+    epte_t *page_table, uint64_t level, gpa_t gpa, hpa_t hpa, gpa_t end,
+    epte_t leaf, uint64_t min_size, uint64_t max_size)
+{
+    const auto size = level_page_size(level);
+    const auto start = gpa;
+
+    for (auto i = level_index(gpa, level); i < page_table::num_entries && gpa < end; i++) {
+        auto &entry = page_table[i];
+
+        // Large pages are not supported at the PML4 level, so the PML4
+        // always points to a PDPT.
+
+        const auto fits =
+            level < pml4e::page_table_level &&
+            size >= min_size && size <= max_size &&
+            is_aligned(gpa, size) && is_aligned(hpa, size) && (end - gpa) >= size;
+
+        if (epte::is_present(entry) && epte::is_leaf_entry(entry)) {
+            throw std::runtime_error("map_range: failed to map gpa, gpa is "
+                                     "already mapped at the " +
+                                     std::to_string(size >> 12U) + "KB level");
+        }
+
+        if (fits && !epte::is_present(entry)) {
+            entry = leaf;
+            epte::set_hpa(entry, hpa);
+
+            gpa += size;
+            hpa += size;
+            continue;
+        }
+
+        if (level == pte::page_table_level) {
+            throw std::runtime_error("map_range: failed to map gpa, range is "
+                                     "not aligned to the minimum page size");
+        }
+
+        if (!epte::is_present(entry)) {
+            this->allocate_page_table(entry);
+        }
+
+        auto child = this->unshare_table(entry);
+        auto bytes = this->map_range(child, level - 1U, gpa, hpa, end, leaf, min_size, max_size);
+
+        gpa += bytes;
+        hpa += bytes;
+    }
+
+    return gpa - start;
+}
+
+epte_t *
+memory_map::split_leaf(epte_t &entry, uint64_t size)
+{
+    const auto child_size = size / page_table::num_entries;
+
+    epte_t table_entry = 0;
+    this->allocate_page_table(table_entry);
+
+    auto child = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(epte::hpa(table_entry)));
+    auto hpa = epte::hpa(entry);
+
+    for (auto i = 0ULL; i < page_table::num_entries; i++) {
+        child[i] = entry;
+        epte::set_hpa(child[i], hpa + (i * child_size));
+    }
+
+    // The child table is fully populated before it replaces the leaf, so a
+    // concurrent walk sees either the old page or the new table, never a
+    // partially filled one.
+
+    entry = table_entry;
+    return child;
+}
+
+bool
+memory_map::merge_table(epte_t &entry, uint64_t size)
+{
+    constexpr const auto ad_mask = epte::accessed_flag::mask | epte::dirty::mask;
+    constexpr const auto attr_mask = ~(epte::phys_addr_bits::mask | ad_mask);
+
+    if (size > m_max_page_size) {
+        return false;
+    }
+
+    const auto child_size = size / page_table::num_entries;
+    const auto child_hpa = epte::hpa(entry);
+
+    if (!this->owns_page_table(child_hpa)) {
+        return false;
+    }
+
+    auto child = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(child_hpa));
+
+    auto first = child[0];
+    if (!epte::is_present(first) || !epte::is_leaf_entry(first) ||
+        !is_aligned(epte::hpa(first), size)) {
+        return false;
+    }
+
+    auto leaf = first;
+    for (auto i = 1ULL; i < page_table::num_entries; i++) {
+        auto &pte = child[i];
+
+        if ((pte & attr_mask) != (first & attr_mask) ||
+            epte::hpa(pte) != epte::hpa(first) + (i * child_size)) {
+            return false;
+        }
+
+        leaf |= (pte & ad_mask);
+    }
+
+    entry = leaf;
+    this->release_page_table(child, child_hpa);
+
+    return true;
+}
+
+std::vector<uint64_t>
+memory_map::harvest(gpa_t gpa, uint64_t len, uint64_t mask)
+{
+    expects(is_aligned(gpa, page_size_4k));
+    expects(is_aligned(len, page_size_4k));
+    expects(len != 0);
+
+    const auto pages = len / page_size_4k;
+    std::vector<uint64_t> bitmap((pages + 63U) / 64U, 0);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pml4 = reinterpret_cast<epte_t *>(g_mm->physint_to_virtint(m_pml4_hpa));
+    this->harvest(pml4, pml4e::page_table_level, gpa, gpa, gpa + len, mask, bitmap);
+    m_generation++;
+
+    ::intel_x64::vmx::invept_single_context(ept::eptp(*this));
+
+    return bitmap;
+}
+
+void
+memory_map::harvest(
+    epte_t *page_table, uint64_t level, gpa_t gpa, gpa_t base, gpa_t end,
+    uint64_t mask, std::vector<uint64_t> &bitmap)
+{
+    const auto size = level_page_size(level);
+
+    for (auto i = level_index(gpa, level); i < page_table::num_entries && gpa < end; i++) {
+        auto &entry = page_table[i];
+        const auto next = std::min((gpa & ~(size - 1U)) + size, end);
+
+        if (!epte::is_present(entry)) {
+            gpa = next;
+            continue;
+        }
+
+        if (!epte::is_leaf_entry(entry)) {
+            auto child = this->unshare_table(entry);
+            this->harvest(child, level - 1U, gpa, base, end, mask, bitmap);
+
+            gpa = next;
+            continue;
+        }
+
+        // The processor sets accessed and dirty flags with locked writes
+        // while other vCPUs run, so a plain read-modify-write could drop a
+        // flag it sets between our read and write.
+        //
+        if ((entry & mask) != 0 &&
+            (__atomic_fetch_and(&entry, ~mask, __ATOMIC_SEQ_CST) & mask) != 0) {
+
+            for (auto page = (gpa - base) / page_size_4k; page < (next - base) / page_size_4k; page++) {
+                bitmap[page / 64U] |= (1ULL << (page % 64U));
+            }
+        }
+
+        gpa = next;
+    }
+}
+
+void
+memory_map::set_suppress_ve(
+    epte_t *page_table, uint64_t level, gpa_t gpa, gpa_t end, bool suppress)
+{
+    const auto size = level_page_size(level);
+
+    for (auto i = level_index(gpa, level); i < page_table::num_entries && gpa < end; i++) {
+        auto &entry = page_table[i];
+
+        const auto entry_end = (gpa & ~(size - 1U)) + size;
+        const auto covered = is_aligned(gpa, size) && end >= entry_end;
+        const auto next = std::min(entry_end, end);
+
+        if (epte::is_present(entry) && !epte::is_leaf_entry(entry)) {
+            auto child = this->unshare_table(entry);
+            this->set_suppress_ve(child, level - 1U, gpa, end, suppress);
+
+            gpa = next;
+            continue;
+        }
+
+        if (!covered) {
+            if (epte::is_present(entry)) {
+                throw std::runtime_error("set_suppress_ve: range only partially "
+                                         "covers a " + std::to_string(size >> 12U) +
+                                         "KB page");
+            }
+
+            gpa = next;
+            continue;
+        }
+
+        if (suppress) {
+            epte::suppress_ve::enable(entry);
+        }
+        else {
+            epte::suppress_ve::disable(entry);
+        }
+
+        gpa = next;
+    }
+}
+
+void
+memory_map::set_suppress_ve(epte_t *page_table)
+{
+    auto pt_view = gsl::make_span(page_table, page_table::num_entries);
+
+    for (auto &entry : pt_view) {
+        if (epte::is_present(entry) && !epte::is_leaf_entry(entry)) {
+            this->set_suppress_ve(this->unshare_table(entry));
+        }
+
+        epte::suppress_ve::enable(entry);
+    }
+}
+
+void
+memory_map::clear_entry(epte_t &entry) const noexcept
+{ entry = m_empty_entry; }
+
+uint64_t
+memory_map::unmap_range(
+    epte_t *page_table, uint64_t level, gpa_t gpa, gpa_t end, uint64_t &reclaimed)
+{
+    const auto size = level_page_size(level);
+    const auto start = gpa;
+
+    for (auto i = level_index(gpa, level); i < page_table::num_entries && gpa < end; i++) {
+        auto &entry = page_table[i];
+
+        const auto entry_end = (gpa & ~(size - 1U)) + size;
+        const auto covered = is_aligned(gpa, size) && end >= entry_end;
+        const auto next = std::min(entry_end, end);
+
+        if (!epte::is_present(entry)) {
+            gpa = next;
+            continue;
+        }
+
+        if (epte::is_leaf_entry(entry)) {
+            if (!covered) {
+                throw std::runtime_error("unmap_range: range only partially "
+                                         "covers a " + std::to_string(size >> 12U) +
+                                         "KB page");
+            }
+
+            this->clear_entry(entry);
+            gpa = next;
+            continue;
+        }
+
+        if (covered) {
+            reclaimed += this->free_page_table(entry);
+            gpa = next;
+            continue;
+        }
+
+        auto child = this->unshare_table(entry);
+        gpa += this->unmap_range(child, level - 1U, gpa, end, reclaimed);
+
+        const auto child_view = gsl::make_span(child, page_table::num_entries);
+        const auto in_use = std::any_of(child_view.begin(), child_view.end(), epte::is_present);
+
+        if (!in_use) {
+            reclaimed += this->free_page_table(entry);
+        }
+    }
+
+    return gpa - start;
+}
+
 epte_t &
 memory_map::map_pdpte_to_page(gpa_t gpa, hpa_t hpa)
 {
@@ -306,6 +1101,9 @@ memory_map::map_pdpte_to_page(gpa_t gpa, hpa_t hpa)
         epte::execute_access::enable(pml4e);
         epte::set_hpa(pml4e, pdpt_hpa);
     }
+    else {
+        this->unshare_table(pml4e);
+    }
 
     auto &pdpte = this->gpa_to_pdpte(gpa, pml4e);
     if (epte::is_present(pdpte)) {
@@ -330,6 +1128,9 @@ memory_map::map_pde_to_page(gpa_t gpa, hpa_t hpa)
         epte::execute_access::enable(pml4e);
         epte::set_hpa(pml4e, pdpt_hpa);
     }
+    else {
+        this->unshare_table(pml4e);
+    }
 
     auto &pdpte = this->gpa_to_pdpte(gpa, pml4e);
     if (epte::entry_type::is_enabled(pdpte)) {
@@ -339,6 +1140,9 @@ memory_map::map_pde_to_page(gpa_t gpa, hpa_t hpa)
     if (!epte::is_present(pdpte)) {
         this->allocate_page_table(pdpte);
     }
+    else {
+        this->unshare_table(pdpte);
+    }
 
     auto &pde = this->gpa_to_pde(gpa, pdpte);
     if (epte::is_present(pde)) {
@@ -363,6 +1167,9 @@ memory_map::map_pte_to_page(gpa_t gpa, hpa_t hpa)
         epte::execute_access::enable(pml4e);
         epte::set_hpa(pml4e, pdpt_hpa);
     }
+    else {
+        this->unshare_table(pml4e);
+    }
 
     auto &pdpte = this->gpa_to_pdpte(gpa, pml4e);
     if (epte::entry_type::is_enabled(pdpte)) {
@@ -372,6 +1179,9 @@ memory_map::map_pte_to_page(gpa_t gpa, hpa_t hpa)
     if (!epte::is_present(pdpte)) {
         this->allocate_page_table(pdpte);
     }
+    else {
+        this->unshare_table(pdpte);
+    }
 
     auto &pde = this->gpa_to_pde(gpa, pdpte);
     if (epte::entry_type::is_enabled(pde)) {
@@ -381,6 +1191,9 @@ memory_map::map_pte_to_page(gpa_t gpa, hpa_t hpa)
     if (!epte::is_present(pde)) {
         this->allocate_page_table(pde);
     }
+    else {
+        this->unshare_table(pde);
+    }
 
     auto &pte = this->gpa_to_pte(gpa, pde);
     if (epte::is_present(pte)) {
@@ -0,0 +1,175 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <arch/intel_x64/pause.h>
+
+#include <hve/arch/intel_x64/apic/vic.h>
+#include <hve/arch/intel_x64/ept/shootdown.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+namespace ept
+{
+
+shootdown::shootdown(memory_map &mem_map) :
+    m_mem_map{mem_map}
+{ }
+
+void
+shootdown::add_cpu(
+    gsl::not_null<eapis::intel_x64::hve *> hve,
+    gsl::not_null<eapis::intel_x64::vic *> vic,
+    uint64_t cpu)
+{
+    auto &mailbox = m_mailboxes.at(cpu);
+
+    mailbox.apic_id = vic->apic_id();
+    mailbox.vmcs = hve->vmcs();
+    mailbox.vic = vic;
+    mailbox.manager = hve->invalidation_manager();
+
+    mailbox.flushed = m_mem_map.generation();
+    mailbox.requested = mailbox.flushed.load();
+
+    vic->reserve_vector(
+        EAPIS_SHOOTDOWN_VECTOR,
+        external_interrupt::handler_delegate_t::create<shootdown, &shootdown::handle>(this)
+    );
+
+    mailbox.online = true;
+}
+
+void
+shootdown::remove_cpu(uint64_t cpu)
+{ m_mailboxes.at(cpu).online = false; }
+
+bool
+shootdown::flush(uint64_t cpu)
+{
+    auto &self = m_mailboxes.at(cpu);
+    expects(self.online);
+
+    const auto generation = m_mem_map.generation();
+
+    self.manager->flush();
+    self.flushed = generation;
+
+    for (auto &mailbox : m_mailboxes) {
+        if (&mailbox == &self || !mailbox.online) {
+            continue;
+        }
+
+        if (this->post(mailbox, generation)) {
+            self.vic->send_ipi(mailbox.apic_id, EAPIS_SHOOTDOWN_VECTOR);
+            m_ipis_sent++;
+        }
+        else {
+            m_ipis_skipped++;
+        }
+    }
+
+    for (auto spin = 0ULL; spin < EAPIS_SHOOTDOWN_SPIN_MAX; spin++) {
+        auto done = true;
+
+        for (const auto &mailbox : m_mailboxes) {
+            if (mailbox.online && mailbox.flushed < generation) {
+                done = false;
+                break;
+            }
+        }
+
+        if (done) {
+            return true;
+        }
+
+        this->service(self);
+        ::intel_x64::pause();
+    }
+
+    return false;
+}
+
+uint64_t
+shootdown::ipis_sent() const noexcept
+{ return m_ipis_sent; }
+
+uint64_t
+shootdown::ipis_skipped() const noexcept
+{ return m_ipis_skipped; }
+
+bool
+shootdown::handle(gsl::not_null<vmcs_t *> vmcs, external_interrupt::info_t &info)
+{
+    bfignored(info);
+
+    for (auto &mailbox : m_mailboxes) {
+        if (mailbox.online && mailbox.vmcs == vmcs) {
+            this->service(mailbox);
+            break;
+        }
+    }
+
+    return true;
+}
+
+// Flushes the mailbox's core if it was asked to, and publishes the
+// generation it flushed up to. Must be called on the mailbox's core.
+//
+// A post() that lands while the core is flushing sees the older request
+// still unacknowledged and does not send an IPI, so requested is read again
+// after publishing and the core keeps flushing until it has caught up.
+
+void
+shootdown::service(mailbox_t &mailbox)
+{
+    auto requested = mailbox.requested.load();
+
+    while (mailbox.flushed < requested) {
+        mailbox.manager->flush();
+        mailbox.flushed = requested;
+
+        requested = mailbox.requested.load();
+    }
+}
+
+// Raises the generation the mailbox's core is asked to flush up to. Returns
+// true if the caller needs to send an IPI, and false if the core already
+// flushed or another core already sent one for this generation.
+
+bool
+shootdown::post(mailbox_t &mailbox, uint64_t generation)
+{
+    if (mailbox.flushed >= generation) {
+        return false;
+    }
+
+    auto requested = mailbox.requested.load();
+    while (requested < generation) {
+        if (mailbox.requested.compare_exchange_weak(requested, generation)) {
+            return requested <= mailbox.flushed;
+        }
+    }
+
+    return false;
+}
+
+}
+}
+}
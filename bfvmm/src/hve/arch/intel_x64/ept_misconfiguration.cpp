@@ -31,9 +31,12 @@ ept_misconfiguration::ept_misconfiguration(
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::ept_misconfiguration,
-        ::handler_delegate_t::create<ept_misconfiguration, &ept_misconfiguration::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<ept_misconfiguration, &ept_misconfiguration::handle>>(this)
     );
 }
 
@@ -59,6 +62,7 @@ ept_misconfiguration::dump_log()
 
             for (const auto &record : m_log) {
                 bfdebug_info(0, "record", msg);
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
                 bfdebug_subnhex(0, "guest virtual address", record.gva, msg);
                 bfdebug_subnhex(0, "guest physical address", record.gpa, msg);
             }
@@ -71,12 +75,16 @@ ept_misconfiguration::dump_log()
 bool
 ept_misconfiguration::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::ept_misconfiguration};
+
     struct info_t info = {
-        vmcs_n::guest_linear_address::get(),
-        vmcs_n::guest_physical_address::get(),
+        m_exit_info->guest_linear_address(),
+        m_exit_info->guest_physical_address(),
         false
     };
 
+    timer.trace(0, info.gpa, info.gva);
+
     if (!ndebug && m_log_enabled) {
         add_record(m_log, {info.gva, info.gpa});
     }
@@ -16,6 +16,8 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <limits>
+
 #include <bfdebug.h>
 #include <hve/arch/intel_x64/hve.h>
 
@@ -31,9 +33,12 @@ ept_violation::ept_violation(
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::ept_violation,
-        ::handler_delegate_t::create<ept_violation, &ept_violation::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<ept_violation, &ept_violation::handle>>(this)
     );
 }
 
@@ -56,6 +61,71 @@ void
 ept_violation::add_execute_handler(handler_delegate_t &&d)
 { m_execute_handlers.push_front(d); }
 
+void
+ept_violation::add_read_handler(uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d)
+{ add_range_handler(m_read_ranges, gpa_s, gpa_e, std::move(d)); }
+
+void
+ept_violation::add_write_handler(uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d)
+{ add_range_handler(m_write_ranges, gpa_s, gpa_e, std::move(d)); }
+
+void
+ept_violation::add_execute_handler(uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d)
+{ add_range_handler(m_execute_ranges, gpa_s, gpa_e, std::move(d)); }
+
+// Makes gpa the start of an interval in the index, giving the new interval
+// a copy of the handlers of the interval it was split from.
+
+static void
+split_interval(std::map<uint64_t, std::list<ept_violation::handler_delegate_t>> &index, uint64_t gpa)
+{
+    auto iter = index.upper_bound(gpa);
+
+    if (iter == index.begin()) {
+        index.emplace(gpa, std::list<ept_violation::handler_delegate_t>{});
+        return;
+    }
+
+    --iter;
+    if (iter->first != gpa) {
+        index.emplace_hint(std::next(iter), gpa, iter->second);
+    }
+}
+
+void
+ept_violation::add_range_handler(
+    range_index_t &index, uint64_t gpa_s, uint64_t gpa_e, handler_delegate_t &&d)
+{
+    expects(gpa_s <= gpa_e);
+
+    const auto last = (gpa_e == std::numeric_limits<uint64_t>::max());
+
+    split_interval(index, gpa_s);
+    if (!last) {
+        split_interval(index, gpa_e + 1U);
+    }
+
+    auto iter = index.find(gpa_s);
+    auto end = last ? index.end() : index.find(gpa_e + 1U);
+
+    for (; iter != end; ++iter) {
+        iter->second.push_front(d);
+    }
+}
+
+const std::list<ept_violation::handler_delegate_t> &
+ept_violation::range_handlers(const range_index_t &index, uint64_t gpa) const
+{
+    static const std::list<handler_delegate_t> s_none;
+
+    auto iter = index.upper_bound(gpa);
+    if (iter == index.begin()) {
+        return s_none;
+    }
+
+    return (--iter)->second;
+}
+
 void
 ept_violation::dump_log()
 {
@@ -79,6 +149,7 @@ ept_violation::dump_log()
                     bfdebug_info(0, "instruction fetch record", msg);
                 }
 
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
                 bfdebug_subnhex(0, "guest virtual address", record.gva, msg);
                 bfdebug_subnhex(0, "guest physical address", record.gpa, msg);
             }
@@ -91,19 +162,23 @@ ept_violation::dump_log()
 bool
 ept_violation::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::ept_violation};
+
     using namespace vmcs_n;
-    auto qual = exit_qualification::ept_violation::get();
+    auto qual = m_exit_info->qualification();
     auto read_access = exit_qualification::ept_violation::data_read::is_enabled(qual);
     auto write_access = exit_qualification::ept_violation::data_write::is_enabled(qual);
     auto execute_access = exit_qualification::ept_violation::instruction_fetch::is_enabled(qual);
 
     struct info_t info = {
-        guest_linear_address::get(),
-        guest_physical_address::get(),
+        m_exit_info->guest_linear_address(),
+        m_exit_info->guest_physical_address(),
         qual,
         false
     };
 
+    timer.trace(info.exit_qualification, info.gpa, info.gva);
+
     if (read_access) {
         return handle_read(vmcs, info);
     }
@@ -137,19 +212,8 @@ ept_violation::handle(gsl::not_null<vmcs_t *> vmcs)
 bool
 ept_violation::handle_read(gsl::not_null<vmcs_t *> vmcs, info_t &info)
 {
-    if (!ndebug && m_log_enabled) {
-        add_record(m_log, {info.gva, info.gpa, info.exit_qualification});
-    }
-
-    for (const auto &d : m_read_handlers) {
-        if (d(vmcs, info)) {
-
-            if (!info.ignore_advance) {
-                return advance(vmcs);
-            }
-
-            return true;
-        }
+    if (dispatch(vmcs, info, m_read_ranges, m_read_handlers)) {
+        return true;
     }
 
     throw std::runtime_error(
@@ -159,19 +223,8 @@ ept_violation::handle_read(gsl::not_null<vmcs_t *> vmcs, info_t &info)
 bool
 ept_violation::handle_write(gsl::not_null<vmcs_t *> vmcs, info_t &info)
 {
-    if (!ndebug && m_log_enabled) {
-        add_record(m_log, {info.gva, info.gpa, info.exit_qualification});
-    }
-
-    for (const auto &d : m_write_handlers) {
-        if (d(vmcs, info)) {
-
-            if (!info.ignore_advance) {
-                return advance(vmcs);
-            }
-
-            return true;
-        }
+    if (dispatch(vmcs, info, m_write_ranges, m_write_handlers)) {
+        return true;
     }
 
     throw std::runtime_error(
@@ -180,23 +233,40 @@ ept_violation::handle_write(gsl::not_null<vmcs_t *> vmcs, info_t &info)
 
 bool
 ept_violation::handle_execute(gsl::not_null<vmcs_t *> vmcs, info_t &info)
+{
+    if (dispatch(vmcs, info, m_execute_ranges, m_execute_handlers)) {
+        return true;
+    }
+
+    throw std::runtime_error("ept_violation: unhandled ept execute violation");
+}
+
+bool
+ept_violation::dispatch(
+    gsl::not_null<vmcs_t *> vmcs, info_t &info,
+    const range_index_t &ranges, const std::list<handler_delegate_t> &hdlrs)
 {
     if (!ndebug && m_log_enabled) {
         add_record(m_log, {info.gva, info.gpa, info.exit_qualification});
     }
 
-    for (const auto &d : m_execute_handlers) {
-        if (d(vmcs, info)) {
+    // Handlers registered for a range containing the gpa are called before
+    // the handlers registered for every gpa
 
-            if (!info.ignore_advance) {
-                return advance(vmcs);
-            }
+    for (const auto *list : {&range_handlers(ranges, info.gpa), &hdlrs}) {
+        for (const auto &d : *list) {
+            if (d(vmcs, info)) {
 
-            return true;
+                if (!info.ignore_advance) {
+                    return advance(vmcs);
+                }
+
+                return true;
+            }
         }
     }
 
-    throw std::runtime_error("ept_violation: unhandled ept execute violation");
+    return false;
 }
 
 }
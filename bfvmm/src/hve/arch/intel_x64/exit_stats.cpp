@@ -0,0 +1,135 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <bfdebug.h>
+#include <hve/arch/intel_x64/exit_stats.h>
+#include <hve/arch/intel_x64/ept/invalidation_manager.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+void
+exit_stats::record(uint64_t reason, uint64_t ticks) noexcept
+{
+    if (reason >= num_reasons) {
+        return;
+    }
+
+    auto bucket = 0ULL;
+    if (ticks > 1) {
+        bucket = 63ULL - static_cast<uint64_t>(__builtin_clzll(ticks));
+    }
+
+    if (bucket >= num_buckets) {
+        bucket = num_buckets - 1;
+    }
+
+    auto &stats = m_reasons[reason];
+
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.ticks.fetch_add(ticks, std::memory_order_relaxed);
+    stats.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+exit_stats::snapshot_t
+exit_stats::snapshot(uint64_t reason) const
+{
+    expects(reason < num_reasons);
+
+    const auto &stats = m_reasons.at(reason);
+    snapshot_t ret{};
+
+    ret.count = stats.count.load(std::memory_order_relaxed);
+    ret.ticks = stats.ticks.load(std::memory_order_relaxed);
+
+    for (auto i = 0ULL; i < num_buckets; i++) {
+        ret.histogram.at(i) = stats.histogram.at(i).load(std::memory_order_relaxed);
+    }
+
+    return ret;
+}
+
+void
+exit_stats::reset() noexcept
+{
+    for (auto &stats : m_reasons) {
+        stats.count.store(0, std::memory_order_relaxed);
+        stats.ticks.store(0, std::memory_order_relaxed);
+
+        for (auto &bucket : stats.histogram) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void
+exit_stats::set_trace(exit_trace *trace) noexcept
+{ m_trace = trace; }
+
+void
+exit_stats::set_info(exit_info *info) noexcept
+{ m_info = info; }
+
+void
+exit_stats::set_invalidation_manager(ept::invalidation_manager *manager) noexcept
+{ m_invalidation_manager = manager; }
+
+void
+exit_stats::flush_invalidations()
+{
+    if (m_invalidation_manager != nullptr) {
+        m_invalidation_manager->flush();
+    }
+}
+
+void
+exit_stats::dump() const
+{
+    bfdebug_transaction(0, [&](std::string * msg) {
+        bfdebug_lnbr(0, msg);
+        bfdebug_info(0, "exit stats", msg);
+        bfdebug_brk2(0, msg);
+
+        for (auto reason = 0ULL; reason < num_reasons; reason++) {
+            const auto stats = this->snapshot(reason);
+
+            if (stats.count == 0) {
+                continue;
+            }
+
+            bfdebug_info(0, "exit reason", msg);
+            bfdebug_subnhex(0, "reason", reason, msg);
+            bfdebug_subndec(0, "count", stats.count, msg);
+            bfdebug_subndec(0, "ticks", stats.ticks, msg);
+            bfdebug_subndec(0, "average", stats.ticks / stats.count, msg);
+
+            for (auto i = 0ULL; i < num_buckets; i++) {
+                if (stats.histogram.at(i) != 0) {
+                    bfdebug_subndec(0, ("< 2^" + std::to_string(i + 1)).c_str(), stats.histogram.at(i), msg);
+                }
+            }
+        }
+
+        bfdebug_lnbr(0, msg);
+    });
+}
+
+}
+}
@@ -0,0 +1,107 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// TIDY_EXCLUSION=-cppcoreguidelines-pro-type-reinterpret-cast
+//
+// Reason:
+//     The ring is shared with the host as raw pages, so its header and
+//     records are laid out in a byte buffer.
+//
+
+#include <bfvmm/memory_manager/memory_manager.h>
+#include <hve/arch/intel_x64/exit_trace.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+exit_trace::exit_trace(uint64_t vcpuid, uint64_t pages) :
+    m_pages{pages}
+{
+    expects(pages > 0);
+
+    // The host maps the ring one page at a time, so it has to start on a
+    // page boundary. The allocation is padded by a page to make room for
+    // aligning it.
+
+    auto size = (pages + 1U) * ::x64::pt::page_size;
+    m_buffer = std::make_unique<uint8_t[]>(size);
+
+    void *ring = m_buffer.get();
+    ensures(std::align(::x64::pt::page_size, pages * ::x64::pt::page_size, ring, size) != nullptr);
+
+    m_ring = static_cast<uint8_t *>(ring);
+    m_header = reinterpret_cast<exit_trace_header_t *>(m_ring);
+    m_records = reinterpret_cast<exit_trace_record_t *>(m_ring + sizeof(exit_trace_header_t));
+
+    m_header->magic = exit_trace_magic;
+    m_header->version = exit_trace_version;
+    m_header->vcpuid = vcpuid;
+    m_header->record_size = sizeof(exit_trace_record_t);
+    m_header->num_records =
+        ((pages * ::x64::pt::page_size) - sizeof(exit_trace_header_t)) / sizeof(exit_trace_record_t);
+    m_header->head = 0;
+}
+
+void
+exit_trace::push(
+    uint64_t reason,
+    uint64_t ticks,
+    uint64_t qualification,
+    uint64_t address,
+    uint64_t value) noexcept
+{
+    const auto head = m_header->head;
+    auto &record = m_records[head % m_header->num_records];
+
+    record.tsc = read_tsc();
+    record.ticks = ticks;
+    record.vcpuid = m_header->vcpuid;
+    record.exit_reason = reason;
+    record.qualification = qualification;
+    record.address = address;
+    record.value = value;
+
+    // The host may be reading the ring while it is being written, so the
+    // record has to be visible before the head that covers it
+
+    __atomic_store_n(&m_header->head, head + 1, __ATOMIC_RELEASE);
+}
+
+gsl::not_null<const exit_trace_header_t *>
+exit_trace::header() const noexcept
+{ return m_header; }
+
+gsl::not_null<const exit_trace_record_t *>
+exit_trace::records() const noexcept
+{ return m_records; }
+
+uint64_t
+exit_trace::pages() const noexcept
+{ return m_pages; }
+
+uintptr_t
+exit_trace::hpa(uint64_t page) const
+{
+    expects(page < m_pages);
+    return g_mm->virtptr_to_physint(m_ring + (page * ::x64::pt::page_size));
+}
+
+}
+}
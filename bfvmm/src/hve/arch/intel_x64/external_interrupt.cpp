@@ -32,9 +32,12 @@ external_interrupt::external_interrupt(gsl::not_null<eapis::intel_x64::hve *> hv
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     hve->exit_handler()->add_handler(
         exit_reason::basic_exit_reason::external_interrupt,
-        ::handler_delegate_t::create<external_interrupt, &external_interrupt::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<external_interrupt, &external_interrupt::handle>>(this)
     );
 }
 
@@ -106,10 +109,14 @@ external_interrupt::dump_log()
 bool
 external_interrupt::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::external_interrupt};
+
     struct info_t info = {
-        vmcs_n::vm_exit_interruption_information::vector::get()
+        vmcs_n::vm_exit_interruption_information::vector::get(m_exit_info->interruption_information())
     };
 
+    timer.trace(0, info.vector);
+
     if (!ndebug && m_log_enabled) {
         m_log.at(info.vector)++;
     }
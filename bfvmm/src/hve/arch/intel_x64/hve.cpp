@@ -38,7 +38,7 @@ hve::hve(
 ) :
     m_exit_handler{exit_handler},
     m_vmcs{vmcs}
-{ }
+{ m_exit_stats.set_info(&m_exit_info); }
 
 gsl::not_null<exit_handler_t *>
 hve::exit_handler()
@@ -48,6 +48,28 @@ gsl::not_null<vmcs_t *>
 hve::vmcs()
 { return m_vmcs; }
 
+gsl::not_null<exit_stats *>
+hve::exit_stats()
+{ return &m_exit_stats; }
+
+gsl::not_null<exit_info *>
+hve::exit_info()
+{ return &m_exit_info; }
+
+gsl::not_null<exit_trace *>
+hve::exit_trace()
+{ return m_exit_trace.get(); }
+
+void
+hve::enable_exit_trace(uint64_t vcpuid, uint64_t pages)
+{
+    if (!m_exit_trace) {
+        m_exit_trace = std::make_unique<eapis::intel_x64::exit_trace>(vcpuid, pages);
+    }
+
+    m_exit_stats.set_trace(m_exit_trace.get());
+}
+
 //--------------------------------------------------------------------------
 // Control Register
 //--------------------------------------------------------------------------
@@ -122,6 +144,16 @@ void hve::add_cpuid_handler(
     m_cpuid->add_handler(leaf, subleaf, std::move(d));
 }
 
+void hve::add_cpuid_handler(
+    cpuid::leaf_t leaf, cpuid::handler_delegate_t &&d)
+{
+    if (!m_cpuid) {
+        m_cpuid = std::make_unique<eapis::intel_x64::cpuid>(this);
+    }
+
+    m_cpuid->add_handler(leaf, std::move(d));
+}
+
 //--------------------------------------------------------------------------
 // External Interrupt
 //--------------------------------------------------------------------------
@@ -327,6 +359,16 @@ void hve::add_ept_read_violation_handler(
     m_ept_violation->add_read_handler(std::move(d));
 }
 
+void hve::add_ept_read_violation_handler(
+    uint64_t gpa_s, uint64_t gpa_e, ept_violation::handler_delegate_t &&d)
+{
+    if (!m_ept_violation) {
+        m_ept_violation = std::make_unique<eapis::intel_x64::ept_violation>(this);
+    }
+
+    m_ept_violation->add_read_handler(gpa_s, gpa_e, std::move(d));
+}
+
 void hve::add_ept_write_violation_handler(
     ept_violation::handler_delegate_t &&d)
 {
@@ -337,6 +379,16 @@ void hve::add_ept_write_violation_handler(
     m_ept_violation->add_write_handler(std::move(d));
 }
 
+void hve::add_ept_write_violation_handler(
+    uint64_t gpa_s, uint64_t gpa_e, ept_violation::handler_delegate_t &&d)
+{
+    if (!m_ept_violation) {
+        m_ept_violation = std::make_unique<eapis::intel_x64::ept_violation>(this);
+    }
+
+    m_ept_violation->add_write_handler(gpa_s, gpa_e, std::move(d));
+}
+
 void hve::add_ept_execute_violation_handler(
     ept_violation::handler_delegate_t &&d)
 {
@@ -347,6 +399,67 @@ void hve::add_ept_execute_violation_handler(
     m_ept_violation->add_execute_handler(std::move(d));
 }
 
+void hve::add_ept_execute_violation_handler(
+    uint64_t gpa_s, uint64_t gpa_e, ept_violation::handler_delegate_t &&d)
+{
+    if (!m_ept_violation) {
+        m_ept_violation = std::make_unique<eapis::intel_x64::ept_violation>(this);
+    }
+
+    m_ept_violation->add_execute_handler(gpa_s, gpa_e, std::move(d));
+}
+
+//--------------------------------------------------------------------------
+// Invalidation
+//--------------------------------------------------------------------------
+
+gsl::not_null<ept::invalidation_manager *> hve::invalidation_manager()
+{ return m_invalidation_manager.get(); }
+
+void hve::enable_invalidation_manager(ept::memory_map &mem_map)
+{
+    if (!m_invalidation_manager) {
+        m_invalidation_manager = std::make_unique<ept::invalidation_manager>(mem_map);
+    }
+
+    m_exit_stats.set_invalidation_manager(m_invalidation_manager.get());
+}
+
+void hve::flush_invalidations()
+{
+    if (m_invalidation_manager) {
+        m_invalidation_manager->flush();
+    }
+}
+
+//--------------------------------------------------------------------------
+// Page-Modification Logging
+//--------------------------------------------------------------------------
+
+gsl::not_null<eapis::intel_x64::pml *> hve::pml()
+{ return m_pml.get(); }
+
+void hve::enable_pml(ept::memory_map &mem_map, ept::gpa_t gpa, uint64_t len)
+{
+    if (!m_pml) {
+        m_pml = std::make_unique<eapis::intel_x64::pml>(this, mem_map, gpa, len);
+    }
+}
+
+//--------------------------------------------------------------------------
+// Virtualization Exception
+//--------------------------------------------------------------------------
+
+gsl::not_null<eapis::intel_x64::ve *> hve::ve()
+{ return m_ve.get(); }
+
+void hve::enable_ve(ept::memory_map &mem_map)
+{
+    if (!m_ve) {
+        m_ve = std::make_unique<eapis::intel_x64::ve>(mem_map);
+    }
+}
+
 //--------------------------------------------------------------------------
 // Checks
 //--------------------------------------------------------------------------
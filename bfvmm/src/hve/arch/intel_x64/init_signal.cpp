@@ -28,9 +28,12 @@ init_signal::init_signal(gsl::not_null<eapis::intel_x64::hve *> hve)
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     hve->exit_handler()->add_handler(
         exit_reason::basic_exit_reason::init_signal,
-        ::handler_delegate_t::create<init_signal, &init_signal::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<init_signal, &init_signal::handle>>(this)
     );
 }
 
@@ -53,6 +56,8 @@ init_signal::dump_log()
 bool
 init_signal::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    const exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::init_signal};
+
     for (const auto &d : m_handlers) {
         if (d(vmcs)) {
             return true;
@@ -28,9 +28,12 @@ interrupt_window::interrupt_window(gsl::not_null<eapis::intel_x64::hve *> hve)
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     hve->exit_handler()->add_handler(
         exit_reason::basic_exit_reason::interrupt_window,
-        ::handler_delegate_t::create<interrupt_window, &interrupt_window::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<interrupt_window, &interrupt_window::handle>>(this)
     );
 }
 
@@ -114,6 +117,8 @@ interrupt_window::dump_log()
 bool
 interrupt_window::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    const exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::interrupt_window};
+
     for (const auto &d : m_handlers) {
         if (d(vmcs)) {
             return true;
@@ -24,6 +24,9 @@
 //     saying the lvalue (d) can't bind to the rvalue.
 //
 
+#include <algorithm>
+#include <cstring>
+
 #include <bfdebug.h>
 #include <hve/arch/intel_x64/hve.h>
 
@@ -34,15 +37,54 @@ namespace eapis
 namespace intel_x64
 {
 
+// Bits 9:7 of the VM-exit instruction-information field hold the address
+// size of an INS/OUTS instruction, which also sets the width of the
+// RCX/RSI/RDI registers it uses (0 = 16-bit, 1 = 32-bit, 2 = 64-bit)
+
+static uint64_t
+string_address_mask(uint64_t instruction_information) noexcept
+{
+    switch ((instruction_information >> 7U) & 0x7U) {
+        case 0:
+            return 0x000000000000FFFFULL;
+
+        case 1:
+            return 0x00000000FFFFFFFFULL;
+
+        default:
+            return 0xFFFFFFFFFFFFFFFFULL;
+    }
+}
+
+// Writes to a 16-bit register leave the rest of the register alone, while
+// writes to a 32-bit register zero extend
+
+static uint64_t
+string_register(uint64_t reg, uint64_t val, uint64_t mask) noexcept
+{
+    if (mask == 0x000000000000FFFFULL) {
+        return set_bits(reg, mask, val);
+    }
+
+    return val & mask;
+}
+
 io_instruction::io_instruction(gsl::not_null<eapis::intel_x64::hve *> hve) :
     m_io_bitmaps{hve->io_bitmaps()},
-    m_exit_handler{hve->exit_handler()}
+    m_exit_handler{hve->exit_handler()},
+    m_port_slots{std::make_unique<uint16_t[]>(0x10000)},
+    m_slots(1)
 {
     using namespace vmcs_n;
 
+    m_slots.front().ports = 0x10000;
+
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::io_instruction,
-        ::handler_delegate_t::create<io_instruction, &io_instruction::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<io_instruction, &io_instruction::handle>>(this)
     );
 }
 
@@ -60,11 +102,84 @@ io_instruction::~io_instruction()
 void
 io_instruction::add_handler(
     vmcs_n::value_type port, handler_delegate_t &&in_d, handler_delegate_t &&out_d)
+{ this->add_handler(port, port, std::move(in_d), std::move(out_d)); }
+
+void
+io_instruction::add_handler(
+    vmcs_n::value_type port_s, vmcs_n::value_type port_e,
+    handler_delegate_t &&in_d, handler_delegate_t &&out_d)
+{ this->add_handlers(port_s, port_e, in_d, out_d, false); }
+
+void
+io_instruction::add_string_handler(
+    vmcs_n::value_type port_s, vmcs_n::value_type port_e,
+    handler_delegate_t &&in_d, handler_delegate_t &&out_d)
+{ this->add_handlers(port_s, port_e, in_d, out_d, true); }
+
+void
+io_instruction::add_handlers(
+    vmcs_n::value_type port_s, vmcs_n::value_type port_e,
+    const handler_delegate_t &in_d, const handler_delegate_t &out_d, bool string)
+{
+    expects(port_s <= port_e);
+
+    if (port_e >= 0x10000) {
+        throw std::runtime_error("invalid port: " + std::to_string(port_e));
+    }
+
+    // Ports in the range that currently share a slot still share one once
+    // the new handlers are added, so registering a block of unclaimed
+    // ports only creates a single slot.
+
+    std::unordered_map<uint16_t, uint32_t> ports;
+
+    for (auto port = port_s; port <= port_e; port++) {
+        trap_on_access(port);
+        ports[m_port_slots[port]]++;
+    }
+
+    std::unordered_map<uint16_t, uint16_t> remap;
+
+    for (const auto &iter : ports) {
+        remap[iter.first] = this->add_slot(iter.first, iter.second, in_d, out_d, string);
+    }
+
+    for (auto port = port_s; port <= port_e; port++) {
+        m_port_slots[port] = remap[m_port_slots[port]];
+    }
+}
+
+uint16_t
+io_instruction::add_slot(
+    uint16_t index, uint32_t ports,
+    const handler_delegate_t &in_d, const handler_delegate_t &out_d, bool string)
 {
-    trap_on_access(port);
+    // A slot whose ports all get the new handlers is extended in place.
+    // Otherwise the ports that do are split off into a copy, so a slot is
+    // never left without ports and there are never more slots than ports.
+
+    if (m_slots.at(index).ports != ports) {
+        auto slot = m_slots.at(index);
 
-    m_in_handlers[port].push_front(std::move(in_d));
-    m_out_handlers[port].push_front(std::move(out_d));
+        slot.ports = ports;
+        m_slots.at(index).ports -= ports;
+
+        m_slots.push_back(std::move(slot));
+        index = gsl::narrow_cast<uint16_t>(m_slots.size() - 1U);
+    }
+
+    auto &slot = m_slots.at(index);
+
+    if (string) {
+        slot.string_in_handlers.push_back(in_d);
+        slot.string_out_handlers.push_back(out_d);
+    }
+    else {
+        slot.in_handlers.push_back(in_d);
+        slot.out_handlers.push_back(out_d);
+    }
+
+    return index;
 }
 
 void
@@ -111,6 +226,7 @@ io_instruction::dump_log()
 
         for (const auto &record : m_log) {
             bfdebug_info(0, "record", msg);
+            bfdebug_subnhex(0, "tsc", record.tsc, msg);
             bfdebug_subnhex(0, "port_number", record.port_number, msg);
             bfdebug_subnhex(0, "size_of_access", record.size_of_access, msg);
             bfdebug_subnhex(0, "direction_of_access", record.direction_of_access, msg);
@@ -129,12 +245,15 @@ io_instruction::dump_log()
 bool
 io_instruction::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::io_instruction};
+
     namespace io_instruction = vmcs_n::exit_qualification::io_instruction;
-    auto eq = io_instruction::get();
+    auto eq = m_exit_info->qualification();
 
     auto reps = 1ULL;
     if (io_instruction::rep_prefixed::is_enabled(eq)) {
-        reps = vmcs->save_state()->rcx & 0x00000000FFFFFFFFULL;
+        const auto mask = string_address_mask(m_exit_info->instruction_information());
+        reps = vmcs->save_state()->rcx & mask;
     }
 
     struct info_t info = {
@@ -156,10 +275,26 @@ io_instruction::handle(gsl::not_null<vmcs_t *> vmcs)
             break;
     }
 
+    timer.trace(eq, info.port_number);
+
     if (io_instruction::string_instruction::is_enabled(eq)) {
-        info.address = vmcs_n::guest_linear_address::get();
+        info.address = m_exit_info->guest_linear_address();
+
+        if (reps > 1) {
+            const auto in =
+                io_instruction::direction_of_access::get(eq) ==
+                io_instruction::direction_of_access::in;
+
+            if (handle_string(vmcs, info, reps, in)) {
+                return true;
+            }
+        }
     }
 
+    // Each element is handled on its own, and the instruction is advanced
+    // past once all of them are. A rep-prefixed instruction with a count
+    // of 0 accesses nothing and is only advanced past.
+
     for (auto i = 0ULL; i < reps; i++) {
         switch (io_instruction::direction_of_access::get(eq)) {
             case io_instruction::direction_of_access::in:
@@ -174,7 +309,13 @@ io_instruction::handle(gsl::not_null<vmcs_t *> vmcs)
         info.address += info.size_of_access + 1ULL;
     }
 
-    return true;
+    timer.trace(eq, info.port_number, info.val);
+
+    if (info.ignore_advance) {
+        return true;
+    }
+
+    return advance(vmcs);
 }
 
 bool
@@ -183,9 +324,9 @@ io_instruction::handle_in(gsl::not_null<vmcs_t *> vmcs, info_t &info)
     namespace io_instruction = vmcs_n::exit_qualification::io_instruction;
 
     const auto &hdlrs =
-        m_in_handlers.find(info.port_number);
+        m_slots[m_port_slots[info.port_number & 0xFFFFULL]].in_handlers;
 
-    if (GSL_LIKELY(hdlrs != m_in_handlers.end())) {
+    if (GSL_LIKELY(!hdlrs.empty())) {
         emulate_in(info);
 
         if (!ndebug && m_log_enabled) {
@@ -198,17 +339,13 @@ io_instruction::handle_in(gsl::not_null<vmcs_t *> vmcs, info_t &info)
             });
         }
 
-        for (const auto &d : hdlrs->second) {
-            if (d(vmcs, info)) {
+        for (auto d = hdlrs.rbegin(); d != hdlrs.rend(); ++d) {
+            if ((*d)(vmcs, info)) {
 
                 if (!info.ignore_write) {
                     store_operand(vmcs, info);
                 }
 
-                if (!info.ignore_advance) {
-                    return advance(vmcs);
-                }
-
                 return true;
             }
         }
@@ -224,9 +361,9 @@ io_instruction::handle_out(gsl::not_null<vmcs_t *> vmcs, info_t &info)
     namespace io_instruction = vmcs_n::exit_qualification::io_instruction;
 
     const auto &hdlrs =
-        m_in_handlers.find(info.port_number);
+        m_slots[m_port_slots[info.port_number & 0xFFFFULL]].out_handlers;
 
-    if (GSL_LIKELY(hdlrs != m_in_handlers.end())) {
+    if (GSL_LIKELY(!hdlrs.empty())) {
         load_operand(vmcs, info);
 
         if (!ndebug && m_log_enabled) {
@@ -239,17 +376,13 @@ io_instruction::handle_out(gsl::not_null<vmcs_t *> vmcs, info_t &info)
             });
         }
 
-        for (const auto &d : hdlrs->second) {
-            if (d(vmcs, info)) {
+        for (auto d = hdlrs.rbegin(); d != hdlrs.rend(); ++d) {
+            if ((*d)(vmcs, info)) {
 
                 if (!info.ignore_write) {
                     emulate_out(info);
                 }
 
-                if (!info.ignore_advance) {
-                    return advance(vmcs);
-                }
-
                 return true;
             }
         }
@@ -259,6 +392,117 @@ io_instruction::handle_out(gsl::not_null<vmcs_t *> vmcs, info_t &info)
         "io_instruction::handle_out: unhandled io instruction #" + std::to_string(info.port_number));
 }
 
+bool
+io_instruction::handle_string(
+    gsl::not_null<vmcs_t *> vmcs, info_t &info, uint64_t reps, bool in)
+{
+    namespace io_instruction = vmcs_n::exit_qualification::io_instruction;
+
+    if (vmcs_n::guest_rflags::direction_flag::is_enabled()) {
+        return false;
+    }
+
+    const auto &slot = m_slots[m_port_slots[info.port_number & 0xFFFFULL]];
+    const auto &hdlrs = in ? slot.string_in_handlers : slot.string_out_handlers;
+
+    if (hdlrs.empty()) {
+        return false;
+    }
+
+    // Map the whole batch at once. The map is virtually contiguous even if
+    // the guest's buffer crosses pages that are not physically contiguous.
+
+    const auto bytes = info.size_of_access + 1ULL;
+    const auto count = std::min(reps, std::max<uint64_t>(EAPIS_IO_STRING_BATCH_MAX / bytes, 1));
+
+    auto map =
+        bfvmm::x64::make_unique_map<uint8_t>(
+            info.address,
+            vmcs_n::guest_cr3::get(),
+            count * bytes
+        );
+
+    info.data = gsl::make_span(map.get(), gsl::narrow_cast<std::ptrdiff_t>(count * bytes));
+
+    // A batch is logged as a single record, with val holding the number of
+    // elements it contained.
+
+    if (!ndebug && m_log_enabled) {
+        add_record(m_log, {
+            info.port_number,
+            info.size_of_access,
+            in ? io_instruction::direction_of_access::in : io_instruction::direction_of_access::out,
+            info.address,
+            count
+        });
+    }
+
+    if (this->dispatch_string(vmcs, info, hdlrs, count, reps, in)) {
+        return true;
+    }
+
+    info.data = {};
+    return false;
+}
+
+bool
+io_instruction::dispatch_string(
+    gsl::not_null<vmcs_t *> vmcs, info_t &info,
+    const std::vector<handler_delegate_t> &hdlrs, uint64_t count, uint64_t reps, bool in)
+{
+    const auto bytes = info.size_of_access + 1ULL;
+
+    // The port is only accessed once a handler has accepted the batch, so
+    // that a batch no string handler wants can still be handed, untouched,
+    // to the per-element handlers.
+
+    for (auto d = hdlrs.rbegin(); d != hdlrs.rend(); ++d) {
+        if ((*d)(vmcs, info)) {
+
+            if (!info.ignore_write) {
+                for (auto i = 0ULL; i < count; i++) {
+                    const auto element = gsl::narrow_cast<std::ptrdiff_t>(i * bytes);
+
+                    if (in) {
+                        emulate_in(info);
+                        std::memcpy(&info.data.at(element), &info.val, bytes);
+                    }
+                    else {
+                        info.val = 0ULL;
+                        std::memcpy(&info.val, &info.data.at(element), bytes);
+                        emulate_out(info);
+                    }
+                }
+
+                info.val = 0ULL;
+            }
+
+            auto state = vmcs->save_state();
+            const auto mask = string_address_mask(m_exit_info->instruction_information());
+
+            if (in) {
+                state->rdi = string_register(state->rdi, state->rdi + (count * bytes), mask);
+            }
+            else {
+                state->rsi = string_register(state->rsi, state->rsi + (count * bytes), mask);
+            }
+
+            state->rcx = string_register(state->rcx, state->rcx - count, mask);
+
+            // If the batch did not cover the whole count, the guest
+            // re-executes the instruction for the remaining elements
+
+            if (count != reps || info.ignore_advance) {
+                return true;
+            }
+
+            return advance(vmcs);
+        }
+    }
+
+    return false;
+}
+
 void
 io_instruction::emulate_in(info_t &info)
 {
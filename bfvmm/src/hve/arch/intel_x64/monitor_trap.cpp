@@ -29,9 +29,12 @@ monitor_trap::monitor_trap(gsl::not_null<eapis::intel_x64::hve *> hve) :
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::monitor_trap_flag,
-        ::handler_delegate_t::create<monitor_trap, &monitor_trap::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<monitor_trap, &monitor_trap::handle>>(this)
     );
 }
 
@@ -57,6 +60,8 @@ monitor_trap::enable()
 bool
 monitor_trap::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    const exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::monitor_trap_flag};
+
     using namespace vmcs_n;
 
     struct info_t info = {
@@ -29,9 +29,12 @@ mov_dr::mov_dr(gsl::not_null<eapis::intel_x64::hve *> hve) :
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::mov_dr,
-        ::handler_delegate_t::create<mov_dr, &mov_dr::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<mov_dr, &mov_dr::handle>>(this)
     );
 
     using namespace vmcs_n;
@@ -67,6 +70,7 @@ mov_dr::dump_log()
 
         for (const auto &record : m_log) {
             bfdebug_info(0, "record", msg);
+            bfdebug_subnhex(0, "tsc", record.tsc, msg);
             bfdebug_subnhex(0, "val", record.val, msg);
         }
 
@@ -81,12 +85,16 @@ mov_dr::dump_log()
 bool
 mov_dr::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::mov_dr};
+
     struct info_t info = {
         this->emulate_rdgpr(vmcs),
         false,
         false
     };
 
+    timer.trace(0, 0, info.val);
+
     if (!ndebug && m_log_enabled) {
         add_record(m_log, {
             info.val
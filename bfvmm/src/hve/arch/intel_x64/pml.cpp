@@ -0,0 +1,173 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <algorithm>
+
+#include <bfdebug.h>
+#include <hve/arch/intel_x64/hve.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+pml::pml(
+    gsl::not_null<eapis::intel_x64::hve *> hve,
+    ept::memory_map &mem_map,
+    ept::gpa_t gpa,
+    uint64_t len
+) :
+    m_exit_handler{hve->exit_handler()},
+    m_mem_map{mem_map},
+    m_log_page{std::make_unique<uint64_t[]>(num_entries)},
+    m_gpa{gpa},
+    m_len{len}
+{
+    using namespace vmcs_n;
+
+    expects(mem_map.accessed_dirty_enabled());
+    expects((gpa & (ept::page_size_4k - 1U)) == 0);
+    expects((len & (ept::page_size_4k - 1U)) == 0);
+    expects(len != 0);
+
+    const auto pages = len / ept::page_size_4k;
+    m_bitmap.resize((pages + 63U) / 64U);
+
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
+    m_exit_handler->add_handler(
+        exit_reason::basic_exit_reason::page_modification_log_full,
+        ::handler_delegate_t::create<base, &base::handle_exit<pml, &pml::handle>>(this)
+    );
+
+    pml_address::set(g_mm->virtptr_to_physint(m_log_page.get()));
+    guest_pml_index::set(num_entries - 1U);
+
+    secondary_processor_based_vm_execution_controls::enable_pml::enable();
+}
+
+pml::~pml()
+{
+    if (!ndebug && m_log_enabled) {
+        dump_log();
+    }
+}
+
+void
+pml::drain()
+{
+    // The index is decremented after each entry is logged, so the valid
+    // entries are the ones above it. Once all 512 entries are used, the
+    // index wraps around to 0xFFFF.
+
+    auto index = vmcs_n::guest_pml_index::get();
+    auto first = (index >= num_entries) ? 0U : index + 1U;
+
+    for (auto i = first; i < num_entries; i++) {
+        const auto gpa = m_log_page[i] & ~(ept::page_size_4k - 1U);
+        if (gpa < m_gpa || gpa - m_gpa >= m_len) {
+            continue;
+        }
+
+        const auto page = (gpa - m_gpa) / ept::page_size_4k;
+        const auto bit = 1ULL << (page % 64U);
+        auto &word = m_bitmap[page / 64U];
+
+        if ((word & bit) == 0) {
+            word |= bit;
+            m_dirty++;
+        }
+    }
+
+    vmcs_n::guest_pml_index::set(num_entries - 1U);
+}
+
+std::vector<uint64_t>
+pml::harvest()
+{
+    this->drain();
+
+    std::vector<uint64_t> dirty;
+    dirty.reserve(m_dirty);
+
+    for (auto i = 0ULL; i < m_bitmap.size(); i++) {
+        for (auto word = m_bitmap[i]; word != 0; word &= word - 1U) {
+            const auto page = (i * 64U) + static_cast<uint64_t>(__builtin_ctzll(word));
+            dirty.push_back(m_gpa + (page * ept::page_size_4k));
+        }
+    }
+
+    // The bitmap is only emptied once the dirty flags are cleared, so the
+    // pages are still reported by the next harvest if that fails. Pages
+    // unmapped since they were logged are skipped by clear_dirty().
+
+    m_mem_map.clear_dirty(dirty);
+
+    std::fill(m_bitmap.begin(), m_bitmap.end(), 0U);
+    m_dirty = 0;
+
+    return dirty;
+}
+
+uint64_t
+pml::dirty_pages() const noexcept
+{ return m_dirty; }
+
+void
+pml::dump_log()
+{
+    if (!m_log.empty()) {
+        bfdebug_transaction(0, [&](std::string * msg) {
+            bfdebug_lnbr(0, msg);
+            bfdebug_info(0, "pml log", msg);
+            bfdebug_brk2(0, msg);
+
+            for (const auto &record : m_log) {
+                bfdebug_info(0, "record", msg);
+                bfdebug_subnhex(0, "tsc", record.tsc, msg);
+                bfdebug_subndec(0, "entries", record.entries, msg);
+            }
+
+            bfdebug_lnbr(0, msg);
+        });
+    }
+}
+
+bool
+pml::handle(gsl::not_null<vmcs_t *> vmcs)
+{
+    const exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::page_modification_log_full};
+
+    bfignored(vmcs);
+
+    const auto dirty = m_dirty;
+    this->drain();
+
+    if (!ndebug && m_log_enabled) {
+        add_record(m_log, {m_dirty - dirty});
+    }
+
+    // The write that filled the log has not been performed yet, so the
+    // guest is resumed without advancing its instruction pointer.
+
+    return true;
+}
+
+}
+}
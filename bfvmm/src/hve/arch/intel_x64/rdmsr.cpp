@@ -30,9 +30,12 @@ rdmsr::rdmsr(gsl::not_null<eapis::intel_x64::hve *> hve) :
 {
     using namespace vmcs_n;
 
+    m_exit_stats = hve->exit_stats();
+    m_exit_info = hve->exit_info();
+
     m_exit_handler->add_handler(
         exit_reason::basic_exit_reason::rdmsr,
-        ::handler_delegate_t::create<rdmsr, &rdmsr::handle>(this)
+        ::handler_delegate_t::create<base, &base::handle_exit<rdmsr, &rdmsr::handle>>(this)
     );
 }
 
@@ -54,7 +57,7 @@ rdmsr::add_handler(
 #ifndef DISABLE_AUTO_TRAP_ON_ACCESS
     this->trap_on_access(msr);
 #endif
-    m_handlers[msr].push_front(d);
+    m_handlers.push_front(msr, std::move(d));
 }
 
 void
@@ -107,6 +110,7 @@ rdmsr::dump_log()
 
         for (const auto &record : m_log) {
             bfdebug_info(0, "record", msg);
+            bfdebug_subnhex(0, "tsc", record.tsc, msg);
             bfdebug_subnhex(0, "msr", record.msr, msg);
             bfdebug_subnhex(0, "val", record.val, msg);
         }
@@ -122,6 +126,7 @@ rdmsr::dump_log()
 bool
 rdmsr::handle(gsl::not_null<vmcs_t *> vmcs)
 {
+    exit_stats::timer timer{m_exit_stats, vmcs_n::exit_reason::basic_exit_reason::rdmsr};
 
     // TODO: IMPORTANT!!!
     //
@@ -136,12 +141,12 @@ rdmsr::handle(gsl::not_null<vmcs_t *> vmcs)
     // this case would be the interrupt code that would then inject a GP.
     //
 
-    const auto &hdlrs =
+    const auto *hdlr =
         m_handlers.find(
             vmcs->save_state()->rcx
         );
 
-    if (GSL_LIKELY(hdlrs != m_handlers.end())) {
+    if (GSL_LIKELY(hdlr != nullptr)) {
 
         struct info_t info = {
             vmcs->save_state()->rcx,
@@ -155,14 +160,16 @@ rdmsr::handle(gsl::not_null<vmcs_t *> vmcs)
                 gsl::narrow_cast<::x64::msrs::field_type>(vmcs->save_state()->rcx)
             );
 
+        timer.trace(0, info.msr, info.val);
+
         if (!ndebug && m_log_enabled) {
             add_record(m_log, {
                 info.msr, info.val
             });
         }
 
-        for (const auto &d : hdlrs->second) {
-            if (d(vmcs, info)) {
+        for (; hdlr != nullptr; hdlr = m_handlers.next(hdlr)) {
+            if (hdlr->d(vmcs, info)) {
 
                 if (!info.ignore_write) {
                     vmcs->save_state()->rax = ((info.val >> 0x00) & 0x00000000FFFFFFFF);
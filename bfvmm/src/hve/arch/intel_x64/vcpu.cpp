@@ -16,6 +16,8 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <mutex>
+
 #include <bfsupport.h>
 #include <bfthreadcontext.h>
 #include <arch/intel_x64/mtrr.h>
@@ -34,11 +36,67 @@ namespace eapis
 namespace intel_x64
 {
 
+// The host-wide EFI memory map is only held weakly here so that it is
+// released once the last vCPU using it is destroyed. Every vCPU translates
+// and maps through the same memory map, which serializes those itself, so
+// g_efi_emm_mutex only guards the state below.
+
+static std::mutex g_efi_emm_mutex;
+static std::weak_ptr<ept::memory_map> g_efi_emm;
+static std::vector<ept::host_memory_region> g_efi_mmap;
+static bool g_efi_lazy_ept = false;
+
+static constexpr const auto efi_identity_map_end = 0x900000000ULL - 0x1000ULL;
+
+static std::shared_ptr<ept::memory_map>
+efi_emm(bool &lazy)
+{
+    std::lock_guard<std::mutex> lock(g_efi_emm_mutex);
+    lazy = g_efi_lazy_ept && g_efi_mmap.empty();
+
+    if (auto emm = g_efi_emm.lock()) {
+        return emm;
+    }
+
+    auto emm = std::make_shared<ept::memory_map>();
+
+    if (!g_efi_mmap.empty()) {
+        ept::identity_map(*emm, g_efi_mmap);
+    }
+    else if (!g_efi_lazy_ept) {
+        ept::identity_map(*emm, 0, efi_identity_map_end);
+    }
+
+    g_efi_emm = emm;
+    return emm;
+}
+
+void
+vcpu::set_efi_memory_map(std::vector<ept::host_memory_region> descriptors)
+{
+    std::lock_guard<std::mutex> lock(g_efi_emm_mutex);
+    g_efi_mmap = std::move(descriptors);
+}
+
+void
+vcpu::set_efi_lazy_ept(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(g_efi_emm_mutex);
+    g_efi_lazy_ept = enabled;
+}
+
 void
 vcpu::enable_efi()
 {
     if (m_emm == nullptr) {
-        m_emm = std::make_unique<eapis::intel_x64::ept::memory_map>();
+        auto lazy = false;
+        m_emm = efi_emm(lazy);
+
+        if (lazy) {
+            m_lazy_map = std::make_unique<ept::lazy_map>(
+                m_hve.get(), *m_emm, 0, efi_identity_map_end
+            );
+        }
     }
 
     if (m_vic == nullptr) {
@@ -48,20 +106,20 @@ vcpu::enable_efi()
     this->add_efi_handlers();
 
     ::vmcs_n::guest_ia32_perf_global_ctrl::reserved::set(0);
-    ept::identity_map(*m_emm, 0, 0x900000000 - 0x1000);
     ept::enable_ept(ept::eptp(*m_emm));
     m_hve->enable_vpid();
+    m_hve->enable_invalidation_manager(*m_emm);
 }
 
 // -----------------------------------------------------------------------------
 // EFI Handlers
 // -----------------------------------------------------------------------------
 
-/// This has to be registered through the base exit_handler because the EAPIs
-/// cpuid handlers are keyed off of {leaf, subleaf}, but in practice, when
-/// firmware calls cpuid, it may not clear out rcx, resulting in random
-/// subleaf values. Until the EAPIs can account for this scenario, this
-/// function will need bypass the EAPIs cpuid interface.
+/// This has to be registered through the base exit_handler. When firmware
+/// calls cpuid, it may not clear out rcx, resulting in random subleaf values,
+/// which the EAPIs cpuid interface can handle using handlers registered for
+/// all subleaves of a leaf. This function, however, also needs to see every
+/// leaf (e.g. the centaur range), which is not keyed by leaf at all.
 
 bool
 vcpu::efi_handle_cpuid(gsl::not_null<vmcs_t *> vmcs)
@@ -425,5 +483,13 @@ gsl::not_null<eapis::intel_x64::vic *> vcpu::vic()
 gsl::not_null<eapis::intel_x64::ept::memory_map *> vcpu::emm()
 { return m_emm.get(); }
 
+void vcpu::set_emm(std::shared_ptr<eapis::intel_x64::ept::memory_map> emm)
+{
+    expects(emm != nullptr);
+    expects(m_vic == nullptr);
+
+    m_emm = std::move(emm);
+}
+
 }
 }
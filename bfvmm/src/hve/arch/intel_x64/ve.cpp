@@ -0,0 +1,82 @@
+//
+// Bareflank Extended APIs
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <bfdebug.h>
+#include <bfvmm/memory_manager/memory_manager.h>
+#include <hve/arch/intel_x64/ve.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+static void
+check_range(ept::gpa_t gpa_s, ept::gpa_t gpa_e)
+{
+    expects(gpa_s < gpa_e);
+    expects((gpa_s & (ept::page_size_4k - 1U)) == 0);
+    expects(((gpa_e + 1U) & (ept::page_size_4k - 1U)) == 0);
+}
+
+ve::ve(ept::memory_map &mem_map) :
+    m_mem_map{mem_map},
+    m_info_page{std::make_unique<uint8_t[]>(::x64::pt::page_size)}
+{
+    using namespace vmcs_n;
+
+    m_mem_map.enable_suppress_ve();
+    this->arm();
+
+    virtualization_exception_information_address::set(this->info_hpa());
+    eptp_index::set(0);
+
+    secondary_processor_based_vm_execution_controls::ept_violation_ve::enable();
+}
+
+void
+ve::add_range(ept::gpa_t gpa_s, ept::gpa_t gpa_e)
+{
+    check_range(gpa_s, gpa_e);
+    m_mem_map.set_suppress_ve(gpa_s, gpa_e - gpa_s + 1U, false);
+}
+
+void
+ve::remove_range(ept::gpa_t gpa_s, ept::gpa_t gpa_e)
+{
+    check_range(gpa_s, gpa_e);
+    m_mem_map.set_suppress_ve(gpa_s, gpa_e - gpa_s + 1U, true);
+}
+
+gsl::not_null<ve::info_t *>
+ve::info() const noexcept
+{ return reinterpret_cast<info_t *>(m_info_page.get()); }
+
+ept::hpa_t
+ve::info_hpa() const noexcept
+{ return g_mm->virtptr_to_physint(m_info_page.get()); }
+
+bool
+ve::is_armed() const noexcept
+{ return this->info()->busy == 0; }
+
+void
+ve::arm() noexcept
+{ this->info()->busy = 0; }
+
+}
+}
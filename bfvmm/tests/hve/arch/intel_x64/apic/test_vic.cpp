@@ -404,6 +404,63 @@ TEST_CASE("vic: add_interrupt_handler")
                 );
 }
 
+static bool g_reserved_vector_handled = false;
+
+static bool
+handle_reserved_vector_stub(
+    gsl::not_null<vmcs_t *> vmcs,
+    eapis::intel_x64::external_interrupt::info_t &info)
+{
+    bfignored(vmcs);
+
+    g_reserved_vector_handled = (info.vector == 0xF2U);
+    return true;
+}
+
+TEST_CASE("vic: reserve_vector")
+{
+    MockRepository mocks;
+    auto mm = setup_mm(mocks);
+    bfignored(mm);
+    auto hve = setup_hve();
+    auto vic = setup_vic(hve.get());
+
+    CHECK_THROWS(vic.reserve_vector(
+                     0x10U,
+                     vic::handler_delegate_t::create<handle_reserved_vector_stub>())
+                );
+
+    vic.reserve_vector(0xF2U, vic::handler_delegate_t::create<handle_reserved_vector_stub>());
+
+    CHECK(vic.phys_to_virt(0xF2U) == 0U);
+    CHECK(vic.virt_to_phys(0xF2U) == 0U);
+    CHECK(vic.virt_to_phys(0xF1U) == 0xF1U);
+    CHECK_THROWS(vic.map(0xF2U, 0x40U));
+
+    vmcs_n::vm_entry_interruption_information::valid_bit::disable();
+    open_interrupt_window();
+
+    g_reserved_vector_handled = false;
+    g_msrs[msrs_n::ia32_x2apic_eoi::addr] = 0xFFU;
+    vic.handle_interrupt(0xF2U);
+
+    CHECK(g_reserved_vector_handled);
+    CHECK(g_msrs[msrs_n::ia32_x2apic_eoi::addr] == 0U);
+    CHECK(vmcs_n::vm_entry_interruption_information::valid_bit::is_disabled());
+}
+
+TEST_CASE("vic: send_ipi")
+{
+    MockRepository mocks;
+    auto mm = setup_mm(mocks);
+    bfignored(mm);
+    auto hve = setup_hve();
+    auto vic = setup_vic(hve.get());
+
+    vic.send_ipi(2U, 0xF2U);
+    CHECK(g_msrs[msrs_n::ia32_x2apic_icr::addr] == 0x00000002000040F2ULL);
+}
+
 TEST_CASE("vic: handle_interrupt_from_exit - window closed")
 {
     namespace entry_intr_info = vmcs_n::vm_entry_interruption_information;
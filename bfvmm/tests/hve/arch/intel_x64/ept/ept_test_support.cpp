@@ -213,8 +213,20 @@ ept_test_support::setup_mock_4k_page(ept::memory_map &map)
 void
 ept_test_support::reset(ept::memory_map &map)
 {
-    m_mock_mem.clear();
-    m_next_phys_addr = 0xF00D0000;
+    map.flush_cache();
+
+    // Only the mock tables are unmapped here. The tables handed out by the
+    // memory map's arena keep their mock addresses, as the arena may hand
+    // them out again after the reset.
+
+    for (auto hva : {reinterpret_cast<uintptr_t>(m_pml4.get()),
+                     reinterpret_cast<uintptr_t>(m_pdpt.get()),
+                     reinterpret_cast<uintptr_t>(m_pd.get()),
+                     reinterpret_cast<uintptr_t>(m_pt.get()),
+                     reinterpret_cast<uintptr_t>(m_page.get())
+                    }) {
+        m_mock_mem.erase(hva);
+    }
 
     for (auto entry : gsl::make_span(m_pml4.get(), ept::page_table::num_entries)) {
         entry = 0xffffffffffffffff;
@@ -266,9 +278,20 @@ ept_test_support::mock_virtint_to_physint(uintptr_t hva)
         return m_mock_mem.at(hva);
     }
 
-    m_next_phys_addr += 0x1000;
-    m_mock_mem[hva] = m_next_phys_addr;
-    return m_next_phys_addr;
+    // Unknown addresses are given their own physically contiguous region so
+    // that the pages of a multi-page allocation translate by offset.
+
+    auto region = m_mock_regions.upper_bound(hva);
+    if (region != m_mock_regions.begin()) {
+        region--;
+        if (hva - region->first < mock_region_size) {
+            return region->second + (hva - region->first);
+        }
+    }
+
+    m_next_phys_addr += mock_region_size;
+    m_mock_regions[hva & ~(ept::page_table::size_bytes - 1U)] = m_next_phys_addr;
+    return m_next_phys_addr + (hva & (ept::page_table::size_bytes - 1U));
 }
 
 void *
@@ -297,6 +320,11 @@ ept_test_support::mock_physint_to_virtint(uintptr_t hpa)
             return x.first;
         }
     }
+    for (auto const &x : m_mock_regions) {
+        if (hpa - x.second < mock_region_size) {
+            return x.first + (hpa - x.second);
+        }
+    }
     std::stringstream msg;
     msg << "invalid test guest physical address: " << std::hex << "0x" << hpa;
     throw std::logic_error(msg.str().c_str());
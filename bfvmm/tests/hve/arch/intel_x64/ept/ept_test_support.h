@@ -37,6 +37,7 @@ constexpr const uintptr_t mock_pdpt_hpa = 0x0000000ABCD00000ULL;
 constexpr const uintptr_t mock_pd_hpa = 0x0000000123400000ULL;
 constexpr const uintptr_t mock_pt_hpa = 0x0000000DCBA00000ULL;
 constexpr const uintptr_t mock_page_hpa = 0x000000000F00D000ULL;
+constexpr const uintptr_t mock_region_size = 0x0000000000100000ULL;
 
 constexpr const uintptr_t mock_1g_hpa = 0xFFFFC0000000ULL;
 constexpr const uintptr_t mock_2m_hpa = 0xFFFFFFE00000ULL;
@@ -151,6 +152,7 @@ private:
     bfvmm::memory_manager *m_mock_mm;
 
     std::map<ept::hva_t, ept::hpa_t> m_mock_mem;
+    std::map<ept::hva_t, ept::hpa_t> m_mock_regions;
     volatile uintptr_t m_next_phys_addr = 0x00000000F00D0000;
     ept::hva_t m_saved_pml4_hva = 0;
 
@@ -69,6 +69,25 @@ TEST_CASE("ept::eptp")
     CHECK(eptp_val == expected);
 }
 
+TEST_CASE("ept::eptp accessed and dirty flags")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    mem_map->m_cap = ::intel_x64::msrs::ia32_vmx_ept_vpid_cap::accessed_dirty_support::mask;
+    mem_map->enable_accessed_dirty();
+
+    uint64_t expected{0ULL};
+    eptp::memory_type::set(expected, eptp::memory_type::write_back);
+    eptp::page_walk_length_minus_one::set(expected, 3ULL);
+    eptp::accessed_and_dirty_flags::enable(expected);
+    eptp::phys_addr::set(expected, mem_map->m_pml4_hpa);
+
+    uint64_t eptp_val = ept::eptp(*mem_map);
+    CHECK(eptp_val == expected);
+}
+
 //--------------------------------------------------------------------------
 // 1GB pages
 //--------------------------------------------------------------------------
@@ -1035,6 +1054,46 @@ TEST_CASE("ept::identity_map_bestfit_hi 4K end page")
     CHECK(ept::epte::entry_type::is_enabled(entry_1g));
 }
 
+TEST_CASE("ept::coalesce")
+{
+    namespace type = ept::host_memory_type;
+
+    CHECK(ept::coalesce({}).empty());
+
+    auto runs = ept::coalesce({
+        {0x5000ULL, 0x1000ULL, type::ram},
+        {0x0ULL, 0x2000ULL, type::ram},
+        {0x2000ULL, 0x1800ULL, type::ram},
+        {0x10000ULL, 0x0ULL, type::ram},
+        {0x20000ULL, 0x1000ULL, type::reserved},
+        {0x21000ULL, 0x1000ULL, type::unusable}
+    });
+
+    REQUIRE(runs.size() == 2U);
+    CHECK(runs[0].base == 0x0ULL);
+    CHECK(runs[0].size == 0x4000ULL);
+    CHECK(runs[1].base == 0x5000ULL);
+    CHECK(runs[1].size == 0x1000ULL);
+
+    runs = ept::coalesce({
+        {0x0ULL, 0x2000ULL, type::ram},
+        {0x2000ULL, 0x1000ULL, type::mmio},
+        {0x1000ULL, 0x4000ULL, type::acpi_nvs},
+        {0x6800ULL, 0x100ULL, type::mmio}
+    });
+
+    REQUIRE(runs.size() == 3U);
+    CHECK(runs[0].base == 0x0ULL);
+    CHECK(runs[0].size == 0x2000ULL);
+    CHECK(runs[0].type == type::ram);
+    CHECK(runs[1].base == 0x2000ULL);
+    CHECK(runs[1].size == 0x3000ULL);
+    CHECK(runs[1].type == type::acpi_nvs);
+    CHECK(runs[2].base == 0x6000ULL);
+    CHECK(runs[2].size == 0x1000ULL);
+    CHECK(runs[2].type == type::mmio);
+}
+
 TEST_CASE("ept::identity_map_bestfit_hi mattr")
 {
     MockRepository mocks;
@@ -0,0 +1,150 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <arch/x64/cpuid.h>
+#include <arch/intel_x64/cpuid.h>
+#include <hve/arch/intel_x64/mtrr.h>
+#include <hve/arch/intel_x64/ept/lazy_map.h>
+#include <support/arch/intel_x64/test_support.h>
+#include "ept_test_support.h"
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace test_ept
+{
+
+namespace ept = eapis::intel_x64::ept;
+namespace qual = vmcs_n::exit_qualification::ept_violation;
+
+constexpr const auto lazy_gpa_s = 0x0000000000000000ULL;
+constexpr const auto lazy_gpa_e = 0x00000000001FF000ULL;
+
+// ept::map() looks up memory types in the physical MTRRs, which are read
+// once, the first time anything is mapped.
+
+static void
+enable_mtrr()
+{
+    using namespace ::intel_x64::mtrr;
+
+    g_edx_cpuid[::intel_x64::cpuid::feature_information::addr] |=
+        ::intel_x64::cpuid::feature_information::edx::mtrr::mask;
+    g_eax_cpuid[::x64::cpuid::addr_size::addr] = 39U;
+
+    ia32_mtrr_def_type::e::enable();
+    g_msrs[ia32_mtrrcap::addr] = 1U;
+
+    const auto mask = eapis::intel_x64::mtrr::size_to_mask(0x1000U, 39U);
+
+    ::intel_x64::msrs::set(ia32_physbase::start_addr, 0x800000U);
+    ::intel_x64::msrs::set(ia32_physmask::start_addr, mask | (1U << 11U));
+}
+
+TEST_CASE("lazy_map: constructor")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    auto hve = setup_hve();
+
+    CHECK_NOTHROW(ept::lazy_map(hve.get(), *mem_map, lazy_gpa_s, lazy_gpa_e));
+    CHECK_THROWS(ept::lazy_map(hve.get(), *mem_map, lazy_gpa_e, lazy_gpa_s));
+    CHECK_THROWS(ept::lazy_map(hve.get(), *mem_map, lazy_gpa_s, lazy_gpa_e, 0x3000U));
+}
+
+TEST_CASE("lazy_map: violations it does not own")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    auto hve = setup_hve();
+
+    ept::lazy_map lm{hve.get(), *mem_map, 0x1000U, lazy_gpa_e, ept::page_size_4k};
+
+    eapis::intel_x64::ept_violation::info_t info{0, 0, 0, false};
+    auto vmcs = hve->vmcs();
+
+    info.gpa = 0x0000U;
+    CHECK_FALSE(lm.handle(vmcs, info));
+
+    info.gpa = lazy_gpa_e + ept::page_size_4k;
+    CHECK_FALSE(lm.handle(vmcs, info));
+
+    info.gpa = 0x1000U;
+    info.exit_qualification = qual::readable::mask;
+    CHECK_FALSE(lm.handle(vmcs, info));
+
+    info.exit_qualification = qual::writeable::mask;
+    CHECK_FALSE(lm.handle(vmcs, info));
+
+    info.exit_qualification = qual::executable::mask;
+    CHECK_FALSE(lm.handle(vmcs, info));
+
+    CHECK_FALSE(info.ignore_advance);
+    CHECK(lm.faulted_regions() == 0U);
+}
+
+TEST_CASE("lazy_map: violation on a region already mapped")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    auto hve = setup_hve();
+
+    ept::lazy_map lm{hve.get(), *mem_map, lazy_gpa_s, lazy_gpa_e, ept::page_size_4k};
+    eapis::intel_x64::ept_violation::info_t info{0, 0x1234U, 0, false};
+
+    mem_map->map(0x1000U, 0x1000U, ept::page_size_4k);
+
+    CHECK(lm.handle(hve->vmcs(), info));
+    CHECK(info.ignore_advance);
+    CHECK(lm.faulted_regions() == 0U);
+}
+
+TEST_CASE("lazy_map: violation maps its region")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    auto hve = setup_hve();
+
+    enable_mtrr();
+
+    ept::lazy_map lm{hve.get(), *mem_map, lazy_gpa_s, lazy_gpa_e, ept::page_size_4k};
+    eapis::intel_x64::ept_violation::info_t info{0, 0x3456U, 0, false};
+
+    CHECK(mem_map->unmapped_size(0x3000U) != 0U);
+    CHECK(lm.handle(hve->vmcs(), info));
+    CHECK(info.ignore_advance);
+    CHECK(lm.faulted_regions() == 1U);
+
+    CHECK(mem_map->unmapped_size(0x3000U) == 0U);
+    CHECK(mem_map->gpa_to_hpa(0x3456U) == 0x3456U);
+    CHECK(mem_map->unmapped_size(0x2000U) != 0U);
+    CHECK(mem_map->unmapped_size(0x4000U) != 0U);
+
+    info.ignore_advance = false;
+    CHECK(lm.handle(hve->vmcs(), info));
+    CHECK(info.ignore_advance);
+    CHECK(lm.faulted_regions() == 1U);
+}
+
+}
+
+#endif
@@ -148,6 +148,459 @@ TEST_CASE("memory_map::gpa_to_epte")
     mock_ept->reset(*mem_map);
 }
 
+TEST_CASE("memory_map::gpa_to_hpa cache")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    mem_map->map(0x200000ULL, mock_2m_hpa, ept::pde::page_size_bytes);
+    CHECK(mem_map->gpa_to_hpa(0x212345ULL) == mock_2m_hpa + 0x12345ULL);
+    CHECK(mem_map->cache_misses() == 1ULL);
+    CHECK(mem_map->cache_hits() == 0ULL);
+
+    CHECK(mem_map->gpa_to_hpa(0x254321ULL) == mock_2m_hpa + 0x54321ULL);
+    CHECK(mem_map->cache_misses() == 1ULL);
+    CHECK(mem_map->cache_hits() == 1ULL);
+
+    mem_map->unmap(0x200000ULL);
+    CHECK_THROWS(mem_map->gpa_to_hpa(0x212345ULL));
+
+    mem_map->map(0x200000ULL, mock_4k_hpa, ept::pte::page_size_bytes);
+    CHECK(mem_map->gpa_to_hpa(0x200123ULL) == mock_4k_hpa + 0x123ULL);
+    CHECK_THROWS(mem_map->gpa_to_hpa(0x201000ULL));
+
+    mem_map->flush_cache();
+    CHECK(mem_map->gpa_to_hpa(0x200123ULL) == mock_4k_hpa + 0x123ULL);
+}
+
+TEST_CASE("memory_map::map_range")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    mem_map->m_max_page_size = ept::page_size_1g;
+
+    auto gpa = ept::page_size_1g - ept::page_size_4k;
+    auto len = ept::page_size_1g + ept::page_size_2m + (2 * ept::page_size_4k);
+    auto mattr = ept::epte::memory_attr::uc_pt;
+
+    mem_map->map_range(gpa, gpa, len, mattr);
+
+    uint64_t size = 0;
+    mem_map->gpa_to_leaf(gpa, size);
+    CHECK(size == ept::page_size_4k);
+    mem_map->gpa_to_leaf(ept::page_size_1g, size);
+    CHECK(size == ept::page_size_1g);
+    mem_map->gpa_to_leaf(2 * ept::page_size_1g, size);
+    CHECK(size == ept::page_size_2m);
+    mem_map->gpa_to_leaf(2 * ept::page_size_1g + ept::page_size_2m, size);
+    CHECK(size == ept::page_size_4k);
+
+    auto entry = mem_map->gpa_to_epte(gpa);
+    CHECK(ept::epte::memory_type::get(entry) == ept::epte::memory_type::uc);
+    CHECK(mem_map->gpa_to_hpa(ept::page_size_1g + 0x1234ULL) == ept::page_size_1g + 0x1234ULL);
+    CHECK_THROWS(mem_map->gpa_to_epte(gpa + len));
+
+    CHECK_THROWS(mem_map->map_range(gpa, gpa, ept::page_size_4k, mattr));
+    CHECK_THROWS(mem_map->map_range(0x1001ULL, 0x1000ULL, ept::page_size_4k, mattr));
+    CHECK_THROWS(mem_map->map_range(0x1000ULL, 0x1000ULL, 0ULL, mattr));
+}
+
+TEST_CASE("memory_map::map_range page size limits")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    uint64_t size = 0;
+
+    mem_map->map_range(
+        0ULL, ept::page_size_4k, ept::page_size_2m, mattr, ept::page_size_4k, ept::page_size_1g
+    );
+    mem_map->gpa_to_leaf(0ULL, size);
+    CHECK(size == ept::page_size_4k);
+
+    mem_map->map_range(
+        ept::page_size_1g, ept::page_size_1g, ept::page_size_1g, mattr,
+        ept::page_size_2m, ept::page_size_2m
+    );
+    mem_map->gpa_to_leaf(ept::page_size_1g, size);
+    CHECK(size == ept::page_size_2m);
+
+    CHECK_THROWS(
+        mem_map->map_range(
+            ept::page_size_2m, ept::page_size_2m, ept::page_size_4k, mattr,
+            ept::page_size_2m, ept::page_size_2m
+        )
+    );
+}
+
+TEST_CASE("memory_map::unmap_range")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    mem_map->m_max_page_size = ept::page_size_1g;
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    auto free_tables = mem_map->m_free_tables.size();
+
+    mem_map->map_range(
+        0ULL, 0ULL, 4 * ept::page_size_2m, mattr, ept::page_size_4k, ept::page_size_4k
+    );
+    mem_map->map_range(ept::page_size_1g, 0ULL, ept::page_size_1g, mattr);
+    CHECK(mem_map->m_free_tables.size() == free_tables - 6U);
+
+    CHECK(mem_map->unmap_range(0x1000ULL, ept::page_size_4k) == 0ULL);
+    CHECK_THROWS(mem_map->gpa_to_epte(0x1000ULL));
+    CHECK(mem_map->gpa_to_hpa(0x2000ULL) == 0x2000ULL);
+
+    CHECK(mem_map->unmap_range(0ULL, ept::page_size_2m) == 1ULL);
+    CHECK_THROWS(mem_map->unmap_range(ept::page_size_1g, ept::page_size_2m));
+    CHECK(mem_map->unmap_range(ept::page_size_2m, 3 * ept::page_size_2m) == 4ULL);
+    CHECK(mem_map->gpa_to_hpa(ept::page_size_1g + 0x10ULL) == 0x10ULL);
+
+    CHECK(mem_map->unmap_range(0ULL, 2 * ept::page_size_1g) == 1ULL);
+    CHECK(mem_map->m_free_tables.size() == free_tables);
+    CHECK(mem_map->unmap_range(0ULL, 2 * ept::page_size_1g) == 0ULL);
+
+    CHECK_THROWS(mem_map->unmap_range(0x1001ULL, ept::page_size_4k));
+    CHECK_THROWS(mem_map->unmap_range(0x1000ULL, 0ULL));
+}
+
+TEST_CASE("memory_map::unmapped_size")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    CHECK(mem_map->unmapped_size(0ULL) == 512ULL * ept::page_size_1g);
+
+    mem_map->map(0x1000ULL, 0x1000ULL, ept::pte::page_size_bytes);
+    CHECK(mem_map->unmapped_size(0x1000ULL) == 0ULL);
+    CHECK(mem_map->unmapped_size(0x2000ULL) == ept::pte::page_size_bytes);
+    CHECK(mem_map->unmapped_size(ept::page_size_2m) == ept::pde::page_size_bytes);
+    CHECK(mem_map->unmapped_size(ept::page_size_1g) == ept::pdpte::page_size_bytes);
+}
+
+TEST_CASE("memory_map::split")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    mem_map->m_max_page_size = ept::page_size_1g;
+
+    auto gpa = ept::page_size_1g;
+    auto hpa = 4 * ept::page_size_1g;
+    uint64_t size = 0;
+
+    mem_map->map_range(gpa, hpa, ept::page_size_1g, ept::epte::memory_attr::uc_pt);
+    auto free_tables = mem_map->m_free_tables.size();
+    auto generation = mem_map->generation();
+
+    auto &pte = mem_map->split(gpa + 0x123456ULL, ept::page_size_4k);
+    CHECK(mem_map->generation() == generation + 1U);
+    CHECK(ept::epte::hpa(pte) == hpa + 0x123000ULL);
+    CHECK(ept::epte::memory_type::get(pte) == ept::epte::memory_type::uc);
+    CHECK(mem_map->m_free_tables.size() == free_tables - 2U);
+
+    mem_map->gpa_to_leaf(gpa + 0x123456ULL, size);
+    CHECK(size == ept::page_size_4k);
+    mem_map->gpa_to_leaf(gpa + ept::page_size_2m, size);
+    CHECK(size == ept::page_size_2m);
+
+    CHECK(mem_map->gpa_to_hpa(gpa + 0x1FFFFULL) == hpa + 0x1FFFFULL);
+    CHECK(mem_map->gpa_to_hpa(gpa + 0x3FFFFFFFULL) == hpa + 0x3FFFFFFFULL);
+    CHECK(&mem_map->split(gpa + 0x123456ULL, ept::page_size_2m) == &pte);
+    CHECK(mem_map->generation() == generation + 1U);
+
+    CHECK_THROWS(mem_map->split(gpa, ept::page_size_1g));
+    CHECK_THROWS(mem_map->split(0ULL, ept::page_size_4k));
+}
+
+TEST_CASE("memory_map::try_merge")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+    mem_map->m_max_page_size = ept::page_size_1g;
+
+    auto gpa = ept::page_size_1g;
+    auto hpa = 4 * ept::page_size_1g;
+    uint64_t size = 0;
+
+    mem_map->map_range(gpa, hpa, ept::page_size_1g, ept::epte::memory_attr::wb_pt);
+    auto free_tables = mem_map->m_free_tables.size();
+
+    auto &pte = mem_map->split(gpa, ept::page_size_4k);
+    ept::epte::write_access::disable(pte);
+    auto generation = mem_map->generation();
+    CHECK_FALSE(mem_map->try_merge(gpa));
+    CHECK(mem_map->generation() == generation);
+
+    ept::epte::write_access::enable(pte);
+    ept::epte::dirty::enable(pte);
+    CHECK(mem_map->try_merge(gpa));
+    CHECK(mem_map->generation() == generation + 1U);
+
+    mem_map->gpa_to_leaf(gpa, size);
+    CHECK(size == ept::page_size_1g);
+    CHECK(ept::epte::dirty::is_enabled(mem_map->gpa_to_epte(gpa)));
+    CHECK(mem_map->m_free_tables.size() == free_tables);
+    CHECK_FALSE(mem_map->try_merge(gpa));
+
+    mem_map->m_max_page_size = ept::page_size_2m;
+    mem_map->split(gpa, ept::page_size_4k);
+    CHECK(mem_map->try_merge(gpa));
+
+    mem_map->gpa_to_leaf(gpa, size);
+    CHECK(size == ept::page_size_2m);
+    CHECK_THROWS(mem_map->try_merge(0ULL));
+}
+
+TEST_CASE("memory_map::enable_accessed_dirty")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    mem_map->m_cap = 0ULL;
+    CHECK_THROWS(mem_map->enable_accessed_dirty());
+    CHECK_FALSE(mem_map->accessed_dirty_enabled());
+
+    mem_map->m_cap = ::intel_x64::msrs::ia32_vmx_ept_vpid_cap::accessed_dirty_support::mask;
+    CHECK_NOTHROW(mem_map->enable_accessed_dirty());
+    CHECK(mem_map->accessed_dirty_enabled());
+}
+
+TEST_CASE("memory_map::harvest")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    auto invepts = 0U;
+    mocks.OnCallFunc(_invept).Do([&](auto, auto) { invepts++; return true; });
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    mem_map->map_range(0ULL, 0ULL, 0x10000ULL, mattr, ept::page_size_4k, ept::page_size_4k);
+    mem_map->map_range(ept::page_size_2m, 0ULL, ept::page_size_2m, mattr, ept::page_size_2m, ept::page_size_2m);
+
+    ept::epte::accessed_flag::enable(mem_map->gpa_to_epte(0x1000ULL));
+    ept::epte::accessed_flag::enable(mem_map->gpa_to_epte(0x3000ULL));
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(0x3000ULL));
+    ept::epte::accessed_flag::enable(mem_map->gpa_to_epte(ept::page_size_2m));
+
+    auto accessed = mem_map->harvest_accessed(0ULL, 0x10000ULL);
+    CHECK(accessed.size() == 1U);
+    CHECK(accessed[0] == 0xAULL);
+
+    accessed = mem_map->harvest_accessed(0ULL, 0x10000ULL);
+    CHECK(accessed[0] == 0ULL);
+
+    auto dirty = mem_map->harvest_dirty(0x2000ULL, 0x2000ULL);
+    CHECK(dirty[0] == 0x2ULL);
+    CHECK(ept::epte::dirty::is_disabled(mem_map->gpa_to_epte(0x3000ULL)));
+
+    accessed = mem_map->harvest_accessed(ept::page_size_2m - 0x1000ULL, 0x41000ULL);
+    CHECK(accessed.size() == 2U);
+    CHECK(accessed[0] == 0xFFFFFFFFFFFFFFFEULL);
+    CHECK(accessed[1] == 0x1ULL);
+    CHECK(ept::epte::accessed_flag::is_disabled(mem_map->gpa_to_epte(ept::page_size_2m)));
+    CHECK(invepts == 4U);
+
+    CHECK_THROWS(mem_map->harvest_dirty(0x1001ULL, 0x1000ULL));
+    CHECK_THROWS(mem_map->harvest_dirty(0x1000ULL, 0ULL));
+    CHECK(invepts == 4U);
+}
+
+TEST_CASE("memory_map::clear_dirty")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    auto invepts = 0U;
+    mocks.OnCallFunc(_invept).Do([&](auto, auto) { invepts++; return true; });
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    mem_map->map_range(0ULL, 0ULL, 0x10000ULL, mattr, ept::page_size_4k, ept::page_size_4k);
+    mem_map->map_range(ept::page_size_2m, 0ULL, ept::page_size_2m, mattr, ept::page_size_2m, ept::page_size_2m);
+
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(0x1000ULL));
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(0x2000ULL));
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(ept::page_size_2m));
+
+    mem_map->clear_dirty({});
+    CHECK(invepts == 0U);
+
+    auto generation = mem_map->generation();
+
+    CHECK_NOTHROW(mem_map->clear_dirty({0x1000ULL, 0x100000ULL, ept::page_size_2m + 0x3000ULL}));
+    CHECK(ept::epte::dirty::is_disabled(mem_map->gpa_to_epte(0x1000ULL)));
+    CHECK(ept::epte::dirty::is_enabled(mem_map->gpa_to_epte(0x2000ULL)));
+    CHECK(ept::epte::dirty::is_disabled(mem_map->gpa_to_epte(ept::page_size_2m)));
+    CHECK(mem_map->generation() == generation + 1U);
+    CHECK(invepts == 1U);
+}
+
+TEST_CASE("memory_map::unshare")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto base = std::make_unique<ept::memory_map>();
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    base->map_range(0ULL, 0ULL, 0x10000ULL, mattr, ept::page_size_4k, ept::page_size_4k);
+    base->map_range(ept::page_size_2m, ept::page_size_2m, ept::page_size_2m, mattr, ept::page_size_2m, ept::page_size_2m);
+
+    auto view = std::make_unique<ept::memory_map>(base.get());
+    CHECK(view->hpa() != base->hpa());
+    CHECK(&view->gpa_to_epte(0x1000ULL) == &base->gpa_to_epte(0x1000ULL));
+
+    auto &pte = view->unshare(0x1000ULL, ept::page_size_4k);
+    CHECK(&pte != &base->gpa_to_epte(0x1000ULL));
+    CHECK(&view->gpa_to_epte(0x1000ULL) == &pte);
+    CHECK(&view->gpa_to_epte(0x2000ULL) != &base->gpa_to_epte(0x2000ULL));
+    CHECK(view->gpa_to_hpa(0x2000ULL) == 0x2000ULL);
+
+    ept::epte::memory_attr::set(pte, ept::epte::memory_attr::wb_eo);
+    CHECK(base->gpa_to_epte(0x1000ULL) != pte);
+
+    auto &split_pte = view->unshare(ept::page_size_2m + 0x3000ULL, ept::page_size_4k);
+    CHECK(view->gpa_to_hpa(ept::page_size_2m + 0x3000ULL) == ept::page_size_2m + 0x3000ULL);
+    CHECK(&split_pte != &base->gpa_to_epte(ept::page_size_2m + 0x3000ULL));
+    CHECK(&base->gpa_to_epte(ept::page_size_2m) == &base->gpa_to_epte(ept::page_size_2m + 0x3000ULL));
+
+    CHECK_THROWS(view->unshare(0x1000ULL, ept::page_size_2m));
+    CHECK_THROWS(view->unshare(ept::page_size_1g, ept::page_size_4k));
+    CHECK_THROWS(view->unshare(0x1000ULL, 0x3000ULL));
+
+    CHECK_FALSE(view->try_merge(0x1000ULL));
+    CHECK(view->unmap_range(0ULL, ept::page_size_1g) > 0U);
+    CHECK(base->gpa_to_hpa(0x2000ULL) == 0x2000ULL);
+    CHECK(base->gpa_to_hpa(ept::page_size_2m + 0x3000ULL) == ept::page_size_2m + 0x3000ULL);
+}
+
+TEST_CASE("memory_map: view changes do not write through to base")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto base = std::make_unique<ept::memory_map>();
+
+    mocks.OnCallFunc(_invept).Return(true);
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    base->map_range(0ULL, 0ULL, 0x10000ULL, mattr, ept::page_size_4k, ept::page_size_4k);
+    base->map_range(ept::page_size_2m, ept::page_size_2m, ept::page_size_2m, mattr, ept::page_size_2m, ept::page_size_2m);
+    ept::epte::dirty::enable(base->gpa_to_epte(0x3000ULL));
+
+    // Each change is made from a new view, so the tables on its path are
+    // still shared with base.
+
+    auto view = std::make_unique<ept::memory_map>(base.get());
+    view->map_range(0x100000ULL, 0x100000ULL, 0x1000ULL, mattr);
+    CHECK(view->gpa_to_hpa(0x100000ULL) == 0x100000ULL);
+    CHECK(base->unmapped_size(0x100000ULL) == ept::page_size_4k);
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    view->map(0x101000ULL, 0x101000ULL, ept::page_size_4k);
+    CHECK(base->unmapped_size(0x101000ULL) == ept::page_size_4k);
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    view->unmap(0x1000ULL);
+    CHECK(base->gpa_to_hpa(0x1000ULL) == 0x1000ULL);
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    view->split(ept::page_size_2m, ept::page_size_4k);
+    CHECK(&base->gpa_to_epte(ept::page_size_2m) == &base->gpa_to_epte(ept::page_size_2m + 0x1000ULL));
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    view->unmap_range(0x4000ULL, 0x1000ULL);
+    CHECK(base->gpa_to_hpa(0x4000ULL) == 0x4000ULL);
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    view->set_suppress_ve(0x5000ULL, 0x1000ULL, true);
+    CHECK(ept::epte::suppress_ve::is_disabled(base->gpa_to_epte(0x5000ULL)));
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    CHECK(view->harvest_dirty(0x3000ULL, 0x1000ULL)[0] == 0x1ULL);
+    CHECK(ept::epte::dirty::is_enabled(base->gpa_to_epte(0x3000ULL)));
+
+    view = std::make_unique<ept::memory_map>(base.get());
+    view->enable_suppress_ve();
+    CHECK(ept::epte::suppress_ve::is_disabled(base->gpa_to_epte(0x6000ULL)));
+    CHECK(ept::epte::suppress_ve::is_enabled(view->gpa_to_epte(0x6000ULL)));
+}
+
+TEST_CASE("memory_map::set_suppress_ve")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    mem_map->map_range(0ULL, 0ULL, 0x10000ULL, mattr, ept::page_size_4k, ept::page_size_4k);
+
+    CHECK_FALSE(mem_map->suppress_ve_enabled());
+    CHECK(ept::epte::suppress_ve::is_disabled(mem_map->gpa_to_epte(0x1000ULL)));
+
+    mem_map->enable_suppress_ve();
+    CHECK(mem_map->suppress_ve_enabled());
+    CHECK(ept::epte::suppress_ve::is_enabled(mem_map->gpa_to_epte(0x1000ULL)));
+
+    mem_map->map_range(ept::page_size_2m, 0ULL, ept::page_size_2m, mattr, ept::page_size_2m, ept::page_size_2m);
+    CHECK(ept::epte::suppress_ve::is_enabled(mem_map->gpa_to_epte(ept::page_size_2m)));
+
+    mem_map->set_suppress_ve(0x2000ULL, 0x2000ULL, false);
+    CHECK(ept::epte::suppress_ve::is_enabled(mem_map->gpa_to_epte(0x1000ULL)));
+    CHECK(ept::epte::suppress_ve::is_disabled(mem_map->gpa_to_epte(0x2000ULL)));
+    CHECK(ept::epte::suppress_ve::is_disabled(mem_map->gpa_to_epte(0x3000ULL)));
+    CHECK(ept::epte::suppress_ve::is_enabled(mem_map->gpa_to_epte(0x4000ULL)));
+
+    mem_map->set_suppress_ve(0x3000ULL, 0x1000ULL, true);
+    CHECK(ept::epte::suppress_ve::is_enabled(mem_map->gpa_to_epte(0x3000ULL)));
+
+    mem_map->unmap(0x1000ULL);
+    CHECK(mem_map->gpa_to_pte(0x1000ULL, mem_map->gpa_to_pde(0x1000ULL,
+          mem_map->gpa_to_pdpte(0x1000ULL, mem_map->gpa_to_pml4e(0x1000ULL)))) ==
+          ept::epte::suppress_ve::mask);
+
+    CHECK_THROWS(mem_map->set_suppress_ve(ept::page_size_2m, 0x1000ULL, false));
+    CHECK_THROWS(mem_map->set_suppress_ve(0x1001ULL, 0x1000ULL, false));
+    CHECK_THROWS(mem_map->set_suppress_ve(0x1000ULL, 0ULL, false));
+}
+
+TEST_CASE("memory_map::generation")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    auto generation = mem_map->generation();
+
+    mem_map->map(0x1000ULL, 0x1000ULL, ept::page_size_4k);
+    mem_map->map_range(ept::page_size_1g, ept::page_size_1g, ept::page_size_1g + ept::page_size_4k);
+    CHECK(mem_map->generation() == generation);
+
+    mem_map->gpa_to_epte(0x1000ULL);
+    mem_map->gpa_to_hpa(0x1000ULL);
+    CHECK(mem_map->generation() == generation);
+
+    mem_map->unmap(0x1000ULL);
+    CHECK(mem_map->generation() == generation + 1U);
+    generation = mem_map->generation();
+
+    mem_map->unmap_range(ept::page_size_1g, ept::page_size_1g + ept::page_size_4k);
+    CHECK(mem_map->generation() == generation + 1U);
+    generation = mem_map->generation();
+
+    mem_map->flush_cache();
+    CHECK(mem_map->generation() == generation + 1U);
+}
+
 TEST_CASE("memory_map::hpa")
 {
     MockRepository mocks;
@@ -168,10 +621,61 @@ TEST_CASE("memory_map::allocate_page_table")
     CHECK(ept::epte::read_access::is_enabled(entry));
     CHECK(ept::epte::write_access::is_enabled(entry));
     CHECK(ept::epte::execute_access::is_enabled(entry));
-    CHECK(ept::epte::memory_type::get(entry) == ept::epte::memory_type::wb);
+    CHECK(ept::epte::entry_type::is_disabled(entry));
     CHECK(ept::epte::hpa(entry));
 }
 
+TEST_CASE("memory_map::allocate_page_table reuses freed tables")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    ept::epte_t entry{0ULL};
+    mem_map->allocate_page_table(entry);
+    auto hpa = ept::epte::hpa(entry);
+    auto free_tables = mem_map->m_free_tables.size();
+
+    mem_map->free_page_table(entry);
+    CHECK(entry == 0ULL);
+    CHECK(mem_map->m_free_tables.size() == free_tables + 1U);
+
+    mem_map->allocate_page_table(entry);
+    CHECK(ept::epte::hpa(entry) == hpa);
+    CHECK(mem_map->m_slabs.size() == 1U);
+}
+
+TEST_CASE("memory_map::allocate_slab")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    for (auto i = 0U; i < EAPIS_EPT_SLAB_SIZE; i++) {
+        ept::epte_t entry{0ULL};
+        mem_map->allocate_page_table(entry);
+    }
+
+    CHECK(mem_map->m_slabs.size() == 2U);
+    CHECK(mem_map->m_free_tables.size() == EAPIS_EPT_SLAB_SIZE - 1U);
+}
+
+TEST_CASE("memory_map::allocate_slab page aligned")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    CHECK((mem_map->m_pml4_hva & (ept::page_table::size_bytes - 1U)) == 0);
+    CHECK((mem_map->m_pml4_hpa & (ept::page_table::size_bytes - 1U)) == 0);
+
+    for (const auto &pt : mem_map->m_free_tables) {
+        CHECK((pt.hva & (ept::page_table::size_bytes - 1U)) == 0);
+        CHECK((pt.hpa & (ept::page_table::size_bytes - 1U)) == 0);
+        CHECK(pt.hpa - mem_map->m_pml4_hpa == pt.hva - mem_map->m_pml4_hva);
+    }
+}
+
 TEST_CASE("memory_map::free_page_table")
 {
     MockRepository mocks;
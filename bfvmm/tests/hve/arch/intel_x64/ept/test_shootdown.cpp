@@ -0,0 +1,195 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <thread>
+
+#include <support/arch/intel_x64/test_support.h>
+#include "ept_test_support.h"
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace test_ept
+{
+
+namespace ept = eapis::intel_x64::ept;
+
+// Mailboxes are brought online by hand, as add_cpu() needs a vic with an
+// initialized x2APIC to read the APIC ID from.
+
+static auto &
+add_mailbox(
+    ept::shootdown &sd, ept::invalidation_manager &manager,
+    ept::memory_map &mem_map, uint64_t cpu)
+{
+    auto &mailbox = sd.m_mailboxes.at(cpu);
+
+    mailbox.manager = &manager;
+    mailbox.flushed = mem_map.generation();
+    mailbox.requested = mailbox.flushed.load();
+    mailbox.online = true;
+
+    return mailbox;
+}
+
+TEST_CASE("shootdown: post and service")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    auto invepts = 0U;
+    mocks.OnCallFunc(_invept).Do([&](auto, auto) { invepts++; return true; });
+
+    ept::shootdown sd{*mem_map};
+    ept::invalidation_manager manager{*mem_map};
+    auto &mailbox = add_mailbox(sd, manager, *mem_map, 1);
+
+    CHECK_FALSE(sd.post(mailbox, mem_map->generation()));
+
+    mem_map->flush_cache();
+    const auto generation = mem_map->generation();
+
+    CHECK(sd.post(mailbox, generation));
+    CHECK_FALSE(sd.post(mailbox, generation));
+    CHECK(mailbox.requested == generation);
+    CHECK(mailbox.flushed < generation);
+
+    sd.service(mailbox);
+    CHECK(mailbox.flushed == generation);
+    CHECK(invepts == 1U);
+
+    sd.service(mailbox);
+    CHECK(invepts == 1U);
+    CHECK_FALSE(sd.post(mailbox, generation));
+}
+
+TEST_CASE("shootdown: post while servicing")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    ept::shootdown sd{*mem_map};
+    ept::invalidation_manager manager{*mem_map};
+    auto &mailbox = add_mailbox(sd, manager, *mem_map, 1);
+
+    mem_map->flush_cache();
+    const auto generation1 = mem_map->generation();
+    REQUIRE(sd.post(mailbox, generation1));
+
+    // The second post lands after the core has started flushing for the
+    // first one, but before it has acknowledged it. The first request is
+    // still outstanding, so no IPI is asked for, and the core has to pick
+    // the second request up on its own.
+
+    auto invepts = 0U;
+    auto posted = false;
+    auto generation2 = 0ULL;
+
+    mocks.OnCallFunc(_invept).Do([&](auto, auto) {
+        if (invepts++ == 0U) {
+            mem_map->flush_cache();
+            generation2 = mem_map->generation();
+            posted = sd.post(mailbox, generation2);
+        }
+        return true;
+    });
+
+    sd.service(mailbox);
+
+    CHECK_FALSE(posted);
+    CHECK(generation2 > generation1);
+    CHECK(mailbox.requested == generation2);
+    CHECK(mailbox.flushed == generation2);
+    CHECK(invepts == 2U);
+}
+
+TEST_CASE("shootdown: flush waits for the other cores")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    std::atomic<uint64_t> invepts{0};
+    mocks.OnCallFunc(_invept).Do([&](auto, auto) { invepts++; return true; });
+
+    ept::shootdown sd{*mem_map};
+    ept::invalidation_manager manager0{*mem_map};
+    ept::invalidation_manager manager1{*mem_map};
+
+    add_mailbox(sd, manager0, *mem_map, 0);
+    auto &other = add_mailbox(sd, manager1, *mem_map, 1);
+
+    // Another core has already posted this generation and sent the IPI, so
+    // flush() only has to wait for the acknowledgement. The thread standing
+    // in for core 1 gives it once core 0 has flushed, so the two never call
+    // the INVEPT mock at the same time.
+
+    mem_map->flush_cache();
+    const auto generation = mem_map->generation();
+    other.requested = generation;
+
+    std::thread core1([&] {
+        while (sd.m_mailboxes.at(0).flushed < generation) {
+            std::this_thread::yield();
+        }
+
+        sd.service(other);
+    });
+
+    CHECK(sd.flush(0));
+    core1.join();
+
+    CHECK(other.flushed == generation);
+    CHECK(sd.m_mailboxes.at(0).flushed == generation);
+    CHECK(invepts == 2U);
+    CHECK(sd.ipis_sent() == 0U);
+    CHECK(sd.ipis_skipped() == 1U);
+}
+
+TEST_CASE("shootdown: flush times out")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<ept_test_support>(mocks);
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    mocks.OnCallFunc(_invept).Return(true);
+
+    ept::shootdown sd{*mem_map};
+    ept::invalidation_manager manager0{*mem_map};
+    ept::invalidation_manager manager1{*mem_map};
+
+    add_mailbox(sd, manager0, *mem_map, 0);
+    auto &other = add_mailbox(sd, manager1, *mem_map, 1);
+
+    mem_map->flush_cache();
+    other.requested = mem_map->generation();
+
+    CHECK_FALSE(sd.flush(0));
+    CHECK(other.flushed < mem_map->generation());
+
+    sd.m_mailboxes.at(1).online = false;
+    CHECK(sd.flush(0));
+
+    CHECK_THROWS(sd.flush(2));
+}
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// TIDY_EXCLUSION=-performance-move-const-arg
+//
+// Reason:
+//     Tidy complains that the std::move(d)'s used in the add_handler calls
+//     have no effect. Removing std::move however results in a compiler error
+//     saying the lvalue (d) can't bind to the rvalue.
+//
+
+#include <support/arch/intel_x64/test_support.h>
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+static uint64_t g_exact_calls = 0;
+static uint64_t g_leaf_calls = 0;
+
+static bool
+exact_handler(gsl::not_null<vmcs_t *> vmcs, cpuid::info_t &info)
+{
+    bfignored(vmcs);
+
+    g_exact_calls++;
+    info.rbx = 0xE;
+
+    return info.rcx == 0;
+}
+
+static bool
+leaf_handler(gsl::not_null<vmcs_t *> vmcs, cpuid::info_t &info)
+{
+    bfignored(vmcs);
+
+    g_leaf_calls++;
+    info.rbx = 0xA;
+
+    return true;
+}
+
+static bool
+uncached_handler(gsl::not_null<vmcs_t *> vmcs, cpuid::info_t &info)
+{
+    bfignored(vmcs);
+
+    g_leaf_calls++;
+    info.ignore_cache = true;
+
+    return true;
+}
+
+static auto
+run_cpuid(
+    gsl::not_null<eapis::intel_x64::hve *> hve, uint64_t leaf, uint64_t subleaf)
+{
+    hve->vmcs()->save_state()->rax = leaf;
+    hve->vmcs()->save_state()->rcx = subleaf;
+
+    CHECK(hve->cpuid()->handle(hve->vmcs()));
+    return hve->vmcs()->save_state()->rbx;
+}
+
+static void
+reset_calls()
+{
+    g_exact_calls = 0;
+    g_leaf_calls = 0;
+}
+
+TEST_CASE("cpuid: pair_hash")
+{
+    pair_hash hash;
+
+    CHECK(hash(std::make_pair(1ULL, 2ULL)) != hash(std::make_pair(2ULL, 1ULL)));
+    CHECK(hash(std::make_pair(1ULL, 0ULL)) != hash(std::make_pair(0ULL, 1ULL)));
+    CHECK(hash(std::make_pair(1ULL, 2ULL)) != hash(std::make_pair(1ULL, 3ULL)));
+    CHECK(hash(std::make_pair(4ULL, 2ULL)) != hash(std::make_pair(5ULL, 2ULL)));
+    CHECK(hash(std::make_pair(1ULL, 2ULL)) == hash(std::make_pair(1ULL, 2ULL)));
+}
+
+TEST_CASE("cpuid: exact handlers run before all-subleaf handlers")
+{
+    auto hve = setup_hve();
+    reset_calls();
+
+    hve->add_cpuid_handler(
+        0x40000000, cpuid::handler_delegate_t::create<leaf_handler>());
+    hve->add_cpuid_handler(
+        0x40000000, 0, cpuid::handler_delegate_t::create<exact_handler>());
+    hve->add_cpuid_handler(
+        0x40000000, 1, cpuid::handler_delegate_t::create<exact_handler>());
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0) == 0xE);
+    CHECK(g_exact_calls == 1);
+    CHECK(g_leaf_calls == 0);
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 1) == 0xA);
+    CHECK(g_exact_calls == 2);
+    CHECK(g_leaf_calls == 1);
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0xBADC0DE) == 0xA);
+    CHECK(g_exact_calls == 2);
+    CHECK(g_leaf_calls == 2);
+}
+
+TEST_CASE("cpuid: cache")
+{
+    auto hve = setup_hve();
+    reset_calls();
+
+    hve->add_cpuid_handler(
+        0x40000000, cpuid::handler_delegate_t::create<leaf_handler>());
+    hve->cpuid()->enable_cache();
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0) == 0xA);
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0) == 0xA);
+    CHECK(g_leaf_calls == 1);
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 1) == 0xA);
+    CHECK(g_leaf_calls == 2);
+
+    hve->add_cpuid_handler(
+        0x40000001, cpuid::handler_delegate_t::create<leaf_handler>());
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0) == 0xA);
+    CHECK(g_leaf_calls == 3);
+
+    hve->cpuid()->disable_cache();
+
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0) == 0xA);
+    CHECK(run_cpuid(hve.get(), 0x40000000, 0) == 0xA);
+    CHECK(g_leaf_calls == 5);
+}
+
+TEST_CASE("cpuid: cache skips state dependent responses")
+{
+    auto hve = setup_hve();
+    reset_calls();
+
+    hve->add_cpuid_handler(
+        0x00000001, cpuid::handler_delegate_t::create<leaf_handler>());
+    hve->add_cpuid_handler(
+        0x0000000B, cpuid::handler_delegate_t::create<leaf_handler>());
+    hve->add_cpuid_handler(
+        0x0000000D, cpuid::handler_delegate_t::create<leaf_handler>());
+    hve->add_cpuid_handler(
+        0x40000000, cpuid::handler_delegate_t::create<uncached_handler>());
+    hve->cpuid()->enable_cache();
+
+    for (const auto leaf : {0x00000001ULL, 0x0000000BULL, 0x0000000DULL, 0x40000000ULL}) {
+        run_cpuid(hve.get(), leaf, 0);
+        run_cpuid(hve.get(), leaf, 0);
+    }
+
+    CHECK(g_leaf_calls == 8);
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,173 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+// TIDY_EXCLUSION=-performance-move-const-arg
+//
+// Reason:
+//     Tidy complains that the std::move(d)'s used in the add_handler calls
+//     have no effect. Removing std::move however results in a compiler error
+//     saying the lvalue (d) can't bind to the rvalue.
+//
+
+#include <vector>
+
+#include <support/arch/intel_x64/test_support.h>
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+static std::vector<uint64_t> g_calls;
+
+template<uint64_t id, bool handled>
+static bool
+test_handler(gsl::not_null<vmcs_t *> vmcs, ept_violation::info_t &info)
+{
+    bfignored(vmcs);
+
+    g_calls.push_back(id);
+    info.ignore_advance = true;
+
+    return handled;
+}
+
+template<uint64_t id>
+static auto
+handler()
+{ return ept_violation::handler_delegate_t::create<test_handler<id, false>>(); }
+
+// Returns the ids of the range handlers registered for gpa, in the order
+// they are called
+
+static auto
+calls(gsl::not_null<eapis::intel_x64::hve *> hve, ept_violation &ev, uint64_t gpa)
+{
+    ept_violation::info_t info{0, gpa, 0, false};
+
+    g_calls.clear();
+    for (const auto &d : ev.range_handlers(ev.m_read_ranges, gpa)) {
+        d(hve->vmcs(), info);
+    }
+
+    return g_calls;
+}
+
+using ids = std::vector<uint64_t>;
+
+TEST_CASE("ept_violation: overlapping ranges")
+{
+    auto hve = setup_hve();
+    ept_violation ev{hve.get()};
+
+    ev.add_read_handler(0x1000, 0x2FFF, handler<1>());
+    ev.add_read_handler(0x2000, 0x3FFF, handler<2>());
+
+    CHECK(ev.m_read_ranges.size() == 4);
+    CHECK(calls(hve.get(), ev, 0x0FFF) == ids{});
+    CHECK(calls(hve.get(), ev, 0x1000) == ids{1});
+    CHECK(calls(hve.get(), ev, 0x1FFF) == ids{1});
+    CHECK(calls(hve.get(), ev, 0x2000) == ids{2, 1});
+    CHECK(calls(hve.get(), ev, 0x2FFF) == ids{2, 1});
+    CHECK(calls(hve.get(), ev, 0x3000) == ids{2});
+    CHECK(calls(hve.get(), ev, 0x3FFF) == ids{2});
+    CHECK(calls(hve.get(), ev, 0x4000) == ids{});
+}
+
+TEST_CASE("ept_violation: adjacent ranges")
+{
+    auto hve = setup_hve();
+    ept_violation ev{hve.get()};
+
+    ev.add_read_handler(0x1000, 0x1FFF, handler<1>());
+    ev.add_read_handler(0x2000, 0x2FFF, handler<2>());
+
+    CHECK(ev.m_read_ranges.size() == 3);
+    CHECK(calls(hve.get(), ev, 0x0FFF) == ids{});
+    CHECK(calls(hve.get(), ev, 0x1FFF) == ids{1});
+    CHECK(calls(hve.get(), ev, 0x2000) == ids{2});
+    CHECK(calls(hve.get(), ev, 0x2FFF) == ids{2});
+    CHECK(calls(hve.get(), ev, 0x3000) == ids{});
+}
+
+TEST_CASE("ept_violation: nested ranges")
+{
+    auto hve = setup_hve();
+    ept_violation ev{hve.get()};
+
+    ev.add_read_handler(0x1000, 0x4FFF, handler<1>());
+    ev.add_read_handler(0x2000, 0x2FFF, handler<2>());
+    ev.add_read_handler(0x0000, 0xFFFF, handler<3>());
+
+    CHECK(calls(hve.get(), ev, 0x0000) == ids{3});
+    CHECK(calls(hve.get(), ev, 0x1000) == ids{3, 1});
+    CHECK(calls(hve.get(), ev, 0x2000) == ids{3, 2, 1});
+    CHECK(calls(hve.get(), ev, 0x2FFF) == ids{3, 2, 1});
+    CHECK(calls(hve.get(), ev, 0x3000) == ids{3, 1});
+    CHECK(calls(hve.get(), ev, 0x5000) == ids{3});
+    CHECK(calls(hve.get(), ev, 0x10000) == ids{});
+}
+
+TEST_CASE("ept_violation: ranges at the edges of the address space")
+{
+    auto hve = setup_hve();
+    ept_violation ev{hve.get()};
+
+    ev.add_read_handler(0xFFFFFFFFFFFFF000, 0xFFFFFFFFFFFFFFFF, handler<1>());
+    ev.add_read_handler(0x0000, 0x0000, handler<2>());
+
+    CHECK(calls(hve.get(), ev, 0x0000) == ids{2});
+    CHECK(calls(hve.get(), ev, 0x0001) == ids{});
+    CHECK(calls(hve.get(), ev, 0xFFFFFFFFFFFFEFFF) == ids{});
+    CHECK(calls(hve.get(), ev, 0xFFFFFFFFFFFFFFFF) == ids{1});
+
+    CHECK_THROWS(ev.add_read_handler(0x2000, 0x1000, handler<3>()));
+}
+
+TEST_CASE("ept_violation: range handlers run before the other handlers")
+{
+    auto hve = setup_hve();
+    ept_violation ev{hve.get()};
+    ept_violation::info_t info{0, 0x1000, 0, false};
+
+    ev.add_read_handler(ept_violation::handler_delegate_t::create<test_handler<1, true>>());
+    ev.add_read_handler(0x1000, 0x1FFF, handler<2>());
+    ev.add_read_handler(0x1000, 0x1FFF, handler<3>());
+
+    g_calls.clear();
+    CHECK(ev.dispatch(hve->vmcs(), info, ev.m_read_ranges, ev.m_read_handlers));
+    CHECK(g_calls == ids{3, 2, 1});
+
+    info.gpa = 0x2000;
+
+    g_calls.clear();
+    CHECK(ev.dispatch(hve->vmcs(), info, ev.m_read_ranges, ev.m_read_handlers));
+    CHECK(g_calls == ids{1});
+
+    g_calls.clear();
+    CHECK_FALSE(ev.dispatch(hve->vmcs(), info, ev.m_read_ranges, ev.m_write_handlers));
+    CHECK(g_calls == ids{});
+}
+
+}
+}
+
+#endif
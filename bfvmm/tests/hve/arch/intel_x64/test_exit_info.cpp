@@ -0,0 +1,109 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+
+#include <hve/arch/intel_x64/hve.h>
+#include <support/arch/intel_x64/test_support.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+TEST_CASE("exit_info: fields")
+{
+    auto hve = setup_hve();
+    auto info = hve->exit_info();
+
+    g_vmcs_fields[vmcs_n::exit_reason::addr] = 10;
+    g_vmcs_fields[vmcs_n::exit_qualification::addr] = 1;
+    g_vmcs_fields[vmcs_n::vm_exit_instruction_length::addr] = 2;
+    g_vmcs_fields[vmcs_n::vm_exit_instruction_information::addr] = 3;
+    g_vmcs_fields[vmcs_n::guest_linear_address::addr] = 4;
+    g_vmcs_fields[vmcs_n::guest_physical_address::addr] = 5;
+    g_vmcs_fields[vmcs_n::vm_exit_interruption_information::addr] = 6;
+
+    CHECK(info->exit_reason() == 10);
+    CHECK(info->qualification() == 1);
+    CHECK(info->instruction_length() == 2);
+    CHECK(info->instruction_information() == 3);
+    CHECK(info->guest_linear_address() == 4);
+    CHECK(info->guest_physical_address() == 5);
+    CHECK(info->interruption_information() == 6);
+
+    info->invalidate();
+}
+
+TEST_CASE("exit_info: cached until invalidated")
+{
+    auto hve = setup_hve();
+    auto info = hve->exit_info();
+
+    g_vmcs_fields[vmcs_n::exit_qualification::addr] = 1;
+    CHECK(info->qualification() == 1);
+
+    g_vmcs_fields[vmcs_n::exit_qualification::addr] = 2;
+    CHECK(info->qualification() == 1);
+
+    info->invalidate();
+    CHECK(info->qualification() == 2);
+
+    info->invalidate();
+}
+
+TEST_CASE("exit_info: invalidated by the exit timer")
+{
+    auto hve = setup_hve();
+    auto info = hve->exit_info();
+
+    g_vmcs_fields[vmcs_n::guest_physical_address::addr] = 0x1000;
+
+    {
+        exit_stats::timer timer{hve->exit_stats(), vmcs_n::exit_reason::basic_exit_reason::ept_violation};
+        CHECK(info->guest_physical_address() == 0x1000);
+
+        g_vmcs_fields[vmcs_n::guest_physical_address::addr] = 0x2000;
+        CHECK(info->guest_physical_address() == 0x1000);
+    }
+
+    CHECK(info->guest_physical_address() == 0x2000);
+    info->invalidate();
+}
+
+TEST_CASE("exit_info: invalidated when the handler throws")
+{
+    auto hve = setup_hve();
+    auto info = hve->exit_info();
+
+    g_vmcs_fields[vmcs_n::guest_physical_address::addr] = 0x1000;
+
+    auto handler = [&] {
+        exit_stats::timer timer{hve->exit_stats(), vmcs_n::exit_reason::basic_exit_reason::ept_violation};
+        CHECK(info->guest_physical_address() == 0x1000);
+
+        throw std::runtime_error("handler failed");
+    };
+
+    CHECK_THROWS(handler());
+
+    g_vmcs_fields[vmcs_n::guest_physical_address::addr] = 0x2000;
+    CHECK(info->guest_physical_address() == 0x2000);
+    info->invalidate();
+}
+
+}
+}
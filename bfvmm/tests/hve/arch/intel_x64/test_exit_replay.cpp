@@ -0,0 +1,173 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+
+#include <cstdlib>
+
+#include <bfvmm/memory_manager/memory_manager.h>
+#include <support/arch/intel_x64/exit_replay.h>
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+// The number of synthetic exits replayed by default. Set
+// EAPIS_EXIT_REPLAY_FILE to replay a dump of an exit trace ring instead.
+//
+constexpr const auto num_exits = 0x10000ULL;
+
+static auto
+setup_mm(MockRepository &mocks)
+{
+    auto mm = mocks.Mock<bfvmm::memory_manager>();
+    mocks.OnCallFunc(bfvmm::memory_manager::instance).Return(mm);
+    mocks.OnCall(mm, bfvmm::memory_manager::virtptr_to_physint).Return(0xCAFE000);
+
+    return mm;
+}
+
+TEST_CASE("exit_replay: synthetic")
+{
+    MockRepository mocks;
+    setup_mm(mocks);
+
+    auto hve = setup_hve();
+    exit_replay replay(hve.get());
+
+    replay.generate(num_exits);
+    CHECK(replay.records().size() == num_exits);
+
+    auto result = replay.run();
+    replay.dump(result);
+
+    CHECK(result.exits == num_exits);
+    CHECK(result.skipped == 0);
+
+    auto total = 0ULL;
+    for (auto reason = 0ULL; reason < exit_stats::num_reasons; reason++) {
+        total += hve->exit_stats()->snapshot(reason).count;
+    }
+
+    CHECK(total == num_exits);
+}
+
+TEST_CASE("exit_replay: synthetic with vmcs store")
+{
+    MockRepository mocks;
+    setup_mm(mocks);
+
+    auto hve = setup_hve();
+    auto guard = setup_vmcs_store(mocks);
+
+    exit_replay replay(hve.get());
+    replay.generate(num_exits);
+
+    auto result = replay.run(0x10);
+    replay.dump(result);
+
+    CHECK(result.exits == num_exits * 0x10);
+    CHECK(result.skipped == 0);
+}
+
+TEST_CASE("exit_replay: recorded")
+{
+    namespace reason = vmcs_n::exit_reason::basic_exit_reason;
+
+    MockRepository mocks;
+    setup_mm(mocks);
+
+    auto hve = setup_hve();
+    hve->enable_exit_trace(0, 1);
+
+    exit_replay recorder(hve.get());
+    recorder.generate(32);
+    recorder.run();
+
+    const auto expected = hve->exit_stats()->snapshot(reason::cpuid).count;
+
+    auto trace = hve->exit_trace();
+    auto ring = gsl::span<const uint8_t>(
+                    reinterpret_cast<const uint8_t *>(trace->header().get()),
+                    gsl::narrow_cast<std::ptrdiff_t>(trace->pages() * ::x64::pt::page_size));
+
+    auto hve2 = setup_hve();
+    exit_replay replay(hve2.get());
+
+    replay.load(ring);
+    CHECK(replay.records().size() == 32);
+
+    auto result = replay.run();
+    CHECK(result.exits == 32);
+    CHECK(hve2->exit_stats()->snapshot(reason::cpuid).count == expected);
+}
+
+TEST_CASE("exit_replay: file")
+{
+    auto filename = std::getenv("EAPIS_EXIT_REPLAY_FILE");
+    if (filename == nullptr) {
+        return;
+    }
+
+    MockRepository mocks;
+    setup_mm(mocks);
+
+    auto hve = setup_hve();
+    exit_replay replay(hve.get());
+
+    CHECK_NOTHROW(replay.load(std::string(filename)));
+    replay.dump(replay.run());
+}
+
+TEST_CASE("exit_replay: invalid ring")
+{
+    MockRepository mocks;
+    setup_mm(mocks);
+
+    auto hve = setup_hve();
+    exit_replay replay(hve.get());
+
+    std::array<uint8_t, 0x1000> ring{};
+    CHECK_THROWS(replay.load(gsl::span<const uint8_t>(ring)));
+    CHECK_THROWS(replay.load(gsl::span<const uint8_t>(ring.data(), 8)));
+    CHECK_THROWS(replay.load(std::string("/invalid/exit/trace")));
+}
+
+TEST_CASE("exit_replay: unsupported exits are skipped")
+{
+    namespace reason = vmcs_n::exit_reason::basic_exit_reason;
+
+    MockRepository mocks;
+    setup_mm(mocks);
+
+    auto hve = setup_hve();
+    exit_replay replay(hve.get());
+
+    replay.add({0, 0, 0, reason::hlt, 0, 0, 0, 0});
+    replay.add({0, 0, 0, reason::cpuid, 0, 0, 0, 0});
+
+    auto result = replay.run();
+    CHECK(result.exits == 1);
+    CHECK(result.skipped == 1);
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,103 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <catch/catch.hpp>
+#include <hve/arch/intel_x64/exit_stats.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+TEST_CASE("exit_stats: empty")
+{
+    exit_stats stats;
+    auto snapshot = stats.snapshot(10);
+
+    CHECK(snapshot.count == 0);
+    CHECK(snapshot.ticks == 0);
+
+    for (const auto &bucket : snapshot.histogram) {
+        CHECK(bucket == 0);
+    }
+}
+
+TEST_CASE("exit_stats: record")
+{
+    exit_stats stats;
+
+    stats.record(10, 0);
+    stats.record(10, 1);
+    stats.record(10, 2);
+    stats.record(10, 3);
+    stats.record(10, 1000);
+
+    auto snapshot = stats.snapshot(10);
+    CHECK(snapshot.count == 5);
+    CHECK(snapshot.ticks == 1006);
+    CHECK(snapshot.histogram.at(0) == 2);
+    CHECK(snapshot.histogram.at(1) == 2);
+    CHECK(snapshot.histogram.at(9) == 1);
+
+    CHECK(stats.snapshot(11).count == 0);
+}
+
+TEST_CASE("exit_stats: large latencies use the last bucket")
+{
+    exit_stats stats;
+
+    stats.record(10, ~0ULL);
+    CHECK(stats.snapshot(10).histogram.at(exit_stats::num_buckets - 1) == 1);
+}
+
+TEST_CASE("exit_stats: invalid reason")
+{
+    exit_stats stats;
+
+    CHECK_NOTHROW(stats.record(exit_stats::num_reasons, 1));
+    CHECK_THROWS(stats.snapshot(exit_stats::num_reasons));
+}
+
+TEST_CASE("exit_stats: reset")
+{
+    exit_stats stats;
+
+    stats.record(10, 100);
+    stats.reset();
+
+    auto snapshot = stats.snapshot(10);
+    CHECK(snapshot.count == 0);
+    CHECK(snapshot.ticks == 0);
+    CHECK(snapshot.histogram.at(6) == 0);
+}
+
+TEST_CASE("exit_stats: timer")
+{
+    exit_stats stats;
+
+    {
+        exit_stats::timer timer{&stats, 10};
+    }
+
+    CHECK(stats.snapshot(10).count == 1);
+    CHECK_NOTHROW(exit_stats::timer(nullptr, 10));
+}
+
+}
+}
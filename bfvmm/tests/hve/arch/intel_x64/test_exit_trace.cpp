@@ -0,0 +1,93 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <catch/catch.hpp>
+#include <hve/arch/intel_x64/exit_trace.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+TEST_CASE("exit_trace: header")
+{
+    exit_trace trace(42, 1);
+    auto header = trace.header();
+
+    CHECK(header->magic == exit_trace_magic);
+    CHECK(header->version == exit_trace_version);
+    CHECK(header->vcpuid == 42);
+    CHECK(header->record_size == sizeof(exit_trace_record_t));
+    CHECK(header->num_records == 63);
+    CHECK(header->head == 0);
+    CHECK(trace.pages() == 1);
+}
+
+TEST_CASE("exit_trace: page aligned")
+{
+    for (auto pages = 1ULL; pages <= 4; pages++) {
+        exit_trace trace(0, pages);
+        const auto addr = reinterpret_cast<uintptr_t>(trace.header().get());
+
+        CHECK((addr & (::x64::pt::page_size - 1U)) == 0);
+        CHECK(trace.header()->num_records ==
+              ((pages * ::x64::pt::page_size) - sizeof(exit_trace_header_t)) / sizeof(exit_trace_record_t));
+    }
+}
+
+TEST_CASE("exit_trace: invalid pages")
+{
+    CHECK_THROWS(exit_trace(0, 0));
+}
+
+TEST_CASE("exit_trace: push")
+{
+    exit_trace trace(42, 1);
+
+    trace.push(31, 100, 1, 0xC0000080, 0x500);
+
+    CHECK(trace.header()->head == 1);
+
+    const auto &record = trace.records().get()[0];
+    CHECK(record.tsc != 0);
+    CHECK(record.ticks == 100);
+    CHECK(record.vcpuid == 42);
+    CHECK(record.exit_reason == 31);
+    CHECK(record.qualification == 1);
+    CHECK(record.address == 0xC0000080);
+    CHECK(record.value == 0x500);
+}
+
+TEST_CASE("exit_trace: overwrites oldest")
+{
+    exit_trace trace(0, 1);
+    const auto num_records = trace.header()->num_records;
+
+    for (auto i = 0ULL; i < num_records + 2; i++) {
+        trace.push(10, i, 0, 0, 0);
+    }
+
+    CHECK(trace.header()->head == num_records + 2);
+    CHECK(trace.records().get()[0].ticks == num_records);
+    CHECK(trace.records().get()[1].ticks == num_records + 1);
+    CHECK(trace.records().get()[2].ticks == 2);
+}
+
+}
+}
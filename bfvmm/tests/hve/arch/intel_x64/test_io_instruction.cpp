@@ -0,0 +1,360 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <array>
+#include <vector>
+
+#include <support/arch/intel_x64/test_support.h>
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+namespace io_n = vmcs_n::exit_qualification::io_instruction;
+
+constexpr const auto test_port = 0x42ULL;
+constexpr const auto test_rip = 0x1000ULL;
+constexpr const auto test_instruction_length = 2ULL;
+
+static std::vector<uint64_t> g_calls;
+
+template<uint64_t id, bool handled, bool ignore_write>
+static bool
+test_handler(gsl::not_null<vmcs_t *> vmcs, io_instruction::info_t &info)
+{
+    bfignored(vmcs);
+
+    g_calls.push_back(id);
+    info.ignore_write = ignore_write;
+
+    return handled;
+}
+
+template<uint64_t id, bool handled = true, bool ignore_write = false>
+static auto
+handler()
+{ return io_instruction::handler_delegate_t::create<test_handler<id, handled, ignore_write>>(); }
+
+// Builds the exit qualification of a one byte INS/OUTS or IN/OUT that
+// uses an immediate port
+
+static uint64_t
+qualification(bool in, bool string, bool rep)
+{
+    auto eq = (test_port << io_n::port_number::from) | io_n::operand_encoding::mask;
+
+    if (in) {
+        eq |= io_n::direction_of_access::mask;
+    }
+
+    if (string) {
+        eq |= io_n::string_instruction::mask;
+    }
+
+    if (rep) {
+        eq |= io_n::rep_prefixed::mask;
+    }
+
+    return eq;
+}
+
+// Bits 9:7 of the instruction information field hold the address size
+
+static void
+setup_exit(uint64_t eq, uint64_t address_size)
+{
+    g_vmcs_fields[vmcs_n::exit_qualification::addr] = eq;
+    g_vmcs_fields[vmcs_n::vm_exit_instruction_information::addr] = address_size << 7U;
+    g_vmcs_fields[vmcs_n::vm_exit_instruction_length::addr] = test_instruction_length;
+    g_vmcs_fields[vmcs_n::guest_linear_address::addr] = 0x2000ULL;
+    g_vmcs_fields[vmcs_n::guest_rflags::addr] = 0ULL;
+
+    g_calls.clear();
+    g_ports.clear();
+}
+
+static auto
+string_info(gsl::span<uint8_t> data)
+{
+    io_instruction::info_t info{test_port, io_n::size_of_access::one_byte, 0x2000ULL, 0ULL, false, false};
+    info.data = data;
+
+    return info;
+}
+
+using handlers = std::vector<io_instruction::handler_delegate_t>;
+using ids = std::vector<uint64_t>;
+
+// Returns the ids of the in handlers in the slot of port, in the order
+// they are called
+
+static auto
+calls(gsl::not_null<eapis::intel_x64::hve *> hve, io_instruction &io, uint64_t port)
+{
+    io_instruction::info_t info{port, io_n::size_of_access::one_byte, 0ULL, 0ULL, false, false};
+    const auto &hdlrs = io.m_slots.at(io.m_port_slots[port]).in_handlers;
+
+    g_calls.clear();
+    for (auto d = hdlrs.rbegin(); d != hdlrs.rend(); ++d) {
+        (*d)(hve->vmcs(), info);
+    }
+
+    return g_calls;
+}
+
+TEST_CASE("io_instruction: overlapping ports")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+
+    io.add_handler(0x10, 0x2F, handler<1, false>(), handler<1, false>());
+    io.add_handler(0x20, 0x3F, handler<2, false>(), handler<2, false>());
+
+    CHECK(io.m_slots.size() == 4);
+    CHECK(calls(hve.get(), io, 0x0F) == ids{});
+    CHECK(calls(hve.get(), io, 0x10) == ids{1});
+    CHECK(calls(hve.get(), io, 0x1F) == ids{1});
+    CHECK(calls(hve.get(), io, 0x20) == ids{2, 1});
+    CHECK(calls(hve.get(), io, 0x2F) == ids{2, 1});
+    CHECK(calls(hve.get(), io, 0x30) == ids{2});
+    CHECK(calls(hve.get(), io, 0x3F) == ids{2});
+    CHECK(calls(hve.get(), io, 0x40) == ids{});
+}
+
+TEST_CASE("io_instruction: adjacent ports")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+
+    io.add_handler(0x10, 0x1F, handler<1, false>(), handler<1, false>());
+    io.add_handler(0x20, 0x2F, handler<2, false>(), handler<2, false>());
+
+    CHECK(io.m_slots.size() == 3);
+    CHECK(calls(hve.get(), io, 0x0F) == ids{});
+    CHECK(calls(hve.get(), io, 0x10) == ids{1});
+    CHECK(calls(hve.get(), io, 0x1F) == ids{1});
+    CHECK(calls(hve.get(), io, 0x20) == ids{2});
+    CHECK(calls(hve.get(), io, 0x2F) == ids{2});
+    CHECK(calls(hve.get(), io, 0x30) == ids{});
+}
+
+TEST_CASE("io_instruction: same ports")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+
+    io.add_handler(0x10, 0x1F, handler<1, false>(), handler<1, false>());
+    io.add_handler(0x10, 0x1F, handler<2, false>(), handler<2, false>());
+
+    CHECK(io.m_slots.size() == 2);
+    CHECK(calls(hve.get(), io, 0x10) == ids{2, 1});
+    CHECK(calls(hve.get(), io, 0x1F) == ids{2, 1});
+    CHECK(calls(hve.get(), io, 0x20) == ids{});
+}
+
+TEST_CASE("io_instruction: full port range")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+
+    io.add_handler(0x0000, 0xFFFF, handler<1, false>(), handler<1, false>());
+
+    CHECK(io.m_slots.size() == 1);
+    CHECK(io.m_slots.front().ports == 0x10000);
+    CHECK(calls(hve.get(), io, 0x0000) == ids{1});
+    CHECK(calls(hve.get(), io, 0xFFFF) == ids{1});
+
+    io.add_handler(0xFFFF, handler<2, false>(), handler<2, false>());
+    io.add_handler(0x0000, handler<3, false>(), handler<3, false>());
+
+    CHECK(io.m_slots.size() == 3);
+    CHECK(io.m_slots.front().ports == 0xFFFE);
+    CHECK(calls(hve.get(), io, 0x0000) == ids{3, 1});
+    CHECK(calls(hve.get(), io, 0x0001) == ids{1});
+    CHECK(calls(hve.get(), io, 0xFFFE) == ids{1});
+    CHECK(calls(hve.get(), io, 0xFFFF) == ids{2, 1});
+
+    CHECK_THROWS(io.add_handler(0xFFFF, 0x10000, handler<4, false>(), handler<4, false>()));
+}
+
+TEST_CASE("io_instruction: string registers wrap at 16 bits")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    setup_exit(qualification(true, true, true), 0);
+    state->rip = test_rip;
+    state->rdi = 0xAAAABBBBCCCCFFFFULL;
+    state->rcx = 0x1111222233330002ULL;
+
+    std::array<uint8_t, 2> buffer{};
+    auto info = string_info(buffer);
+
+    CHECK(io.dispatch_string(hve->vmcs(), info, handlers{handler<1>()}, 2, 2, true));
+    CHECK(state->rdi == 0xAAAABBBBCCCC0001ULL);
+    CHECK(state->rcx == 0x1111222233330000ULL);
+    CHECK(state->rip == test_rip + test_instruction_length);
+
+    hve->exit_info()->invalidate();
+}
+
+TEST_CASE("io_instruction: string registers wrap at 32 bits")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    setup_exit(qualification(false, true, true), 1);
+    state->rip = test_rip;
+    state->rsi = 0xAAAABBBBFFFFFFFFULL;
+    state->rcx = 0xFFFFFFFF00000002ULL;
+
+    std::array<uint8_t, 2> buffer{0x12, 0x34};
+    auto info = string_info(buffer);
+
+    CHECK(io.dispatch_string(hve->vmcs(), info, handlers{handler<1>()}, 2, 2, false));
+    CHECK(state->rsi == 0x0000000000000001ULL);
+    CHECK(state->rcx == 0ULL);
+    CHECK(state->rip == test_rip + test_instruction_length);
+    CHECK(g_ports[test_port] == 0x34U);
+
+    hve->exit_info()->invalidate();
+}
+
+TEST_CASE("io_instruction: partial string batch")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    setup_exit(qualification(true, true, true), 2);
+    state->rip = test_rip;
+    state->rdi = 0x3000ULL;
+    state->rcx = 5ULL;
+
+    std::array<uint8_t, 2> buffer{};
+    auto info = string_info(buffer);
+
+    // The guest re-executes the instruction for the 3 remaining elements,
+    // so its instruction pointer is left alone
+
+    CHECK(io.dispatch_string(hve->vmcs(), info, handlers{handler<1>()}, 2, 5, true));
+    CHECK(state->rdi == 0x3002ULL);
+    CHECK(state->rcx == 3ULL);
+    CHECK(state->rip == test_rip);
+
+    hve->exit_info()->invalidate();
+}
+
+TEST_CASE("io_instruction: string batch not accepted")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    setup_exit(qualification(false, true, true), 2);
+    state->rip = test_rip;
+    state->rsi = 0x3000ULL;
+    state->rcx = 2ULL;
+
+    std::array<uint8_t, 2> buffer{0x12, 0x34};
+    auto info = string_info(buffer);
+
+    CHECK_FALSE(io.dispatch_string(hve->vmcs(), info, handlers{handler<1, false>(), handler<2, false>()}, 2, 2, false));
+    CHECK(g_calls == std::vector<uint64_t>{2, 1});
+    CHECK(g_ports.count(test_port) == 0);
+    CHECK(state->rsi == 0x3000ULL);
+    CHECK(state->rcx == 2ULL);
+    CHECK(state->rip == test_rip);
+
+    hve->exit_info()->invalidate();
+}
+
+TEST_CASE("io_instruction: string with direction flag set")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    io.add_string_handler(test_port, test_port, handler<1>(), handler<1>());
+    io.add_handler(test_port, handler<2, true, true>(), handler<2, true, true>());
+
+    setup_exit(qualification(true, true, true), 2);
+    g_vmcs_fields[vmcs_n::guest_rflags::addr] = vmcs_n::guest_rflags::direction_flag::mask;
+    state->rip = test_rip;
+    state->rcx = 3ULL;
+
+    auto info = string_info({});
+    CHECK_FALSE(io.handle_string(hve->vmcs(), info, 3, true));
+    CHECK(g_calls.empty());
+
+    // Each element goes to the per-element handlers, and the instruction
+    // is only advanced past once
+
+    CHECK(io.handle(hve->vmcs()));
+    CHECK(g_calls == std::vector<uint64_t>{2, 2, 2});
+    CHECK(state->rip == test_rip + test_instruction_length);
+
+    g_vmcs_fields[vmcs_n::guest_rflags::addr] = 0ULL;
+}
+
+TEST_CASE("io_instruction: rep with a count of 0")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    io.add_handler(test_port, handler<1>(), handler<1>());
+
+    setup_exit(qualification(false, true, true), 2);
+    state->rip = test_rip;
+    state->rcx = 0ULL;
+
+    CHECK(io.handle(hve->vmcs()));
+    CHECK(g_calls.empty());
+    CHECK(g_ports.count(test_port) == 0);
+    CHECK(state->rip == test_rip + test_instruction_length);
+}
+
+TEST_CASE("io_instruction: single access")
+{
+    auto hve = setup_hve();
+    io_instruction io{hve.get()};
+    auto state = hve->vmcs()->save_state();
+
+    io.add_handler(test_port, handler<1>(), handler<1>());
+
+    setup_exit(qualification(false, false, false), 2);
+    state->rip = test_rip;
+    state->rax = 0x56ULL;
+
+    CHECK(io.handle(hve->vmcs()));
+    CHECK(g_calls == std::vector<uint64_t>{1});
+    CHECK(g_ports[test_port] == 0x56U);
+    CHECK(state->rip == test_rip + test_instruction_length);
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,108 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <catch/catch.hpp>
+#include <hve/arch/intel_x64/msr_handler_table.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+using table_t = msr_handler_table<int>;
+
+static std::vector<int>
+handlers(const table_t &table, uint64_t msr)
+{
+    std::vector<int> ret;
+
+    for (auto entry = table.find(msr); entry != nullptr; entry = table.next(entry)) {
+        ret.push_back(entry->d);
+    }
+
+    return ret;
+}
+
+TEST_CASE("msr_handler_table: empty")
+{
+    table_t table;
+
+    CHECK(table.find(0x0) == nullptr);
+    CHECK(table.find(0x1FFF) == nullptr);
+    CHECK(table.find(0xC0000080) == nullptr);
+    CHECK(table.find(0x40000000) == nullptr);
+}
+
+TEST_CASE("msr_handler_table: low window")
+{
+    table_t table;
+
+    table.push_front(0x0, 1);
+    table.push_front(0x1FFF, 2);
+
+    CHECK(handlers(table, 0x0) == std::vector<int>({1}));
+    CHECK(handlers(table, 0x1FFF) == std::vector<int>({2}));
+    CHECK(handlers(table, 0x1) == std::vector<int>());
+    CHECK(handlers(table, 0xC0000000) == std::vector<int>());
+}
+
+TEST_CASE("msr_handler_table: high window")
+{
+    table_t table;
+
+    table.push_front(0xC0000000, 1);
+    table.push_front(0xC0001FFF, 2);
+
+    CHECK(handlers(table, 0xC0000000) == std::vector<int>({1}));
+    CHECK(handlers(table, 0xC0001FFF) == std::vector<int>({2}));
+    CHECK(handlers(table, 0x0) == std::vector<int>());
+    CHECK(handlers(table, 0x1FFF) == std::vector<int>());
+}
+
+TEST_CASE("msr_handler_table: overflow")
+{
+    table_t table;
+
+    table.push_front(0x2000, 1);
+    table.push_front(0x40000000, 2);
+    table.push_front(0xC0002000, 3);
+
+    CHECK(handlers(table, 0x2000) == std::vector<int>({1}));
+    CHECK(handlers(table, 0x40000000) == std::vector<int>({2}));
+    CHECK(handlers(table, 0xC0002000) == std::vector<int>({3}));
+    CHECK(handlers(table, 0x0) == std::vector<int>());
+}
+
+TEST_CASE("msr_handler_table: most recent first")
+{
+    table_t table;
+
+    table.push_front(0x10, 1);
+    table.push_front(0x6E0, 2);
+    table.push_front(0x10, 3);
+    table.push_front(0x40000000, 4);
+    table.push_front(0x40000000, 5);
+
+    CHECK(handlers(table, 0x10) == std::vector<int>({3, 1}));
+    CHECK(handlers(table, 0x6E0) == std::vector<int>({2}));
+    CHECK(handlers(table, 0x40000000) == std::vector<int>({5, 4}));
+}
+
+}
+}
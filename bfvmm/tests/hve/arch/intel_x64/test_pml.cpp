@@ -0,0 +1,150 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <support/arch/intel_x64/test_support.h>
+#include "ept/ept_test_support.h"
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+constexpr const auto tracked_len = 0x100000ULL;
+
+static auto
+setup_mem_map()
+{
+    auto mem_map = std::make_unique<ept::memory_map>();
+
+    mem_map->m_cap = ::intel_x64::msrs::ia32_vmx_ept_vpid_cap::accessed_dirty_support::mask;
+    mem_map->enable_accessed_dirty();
+
+    auto mattr = ept::epte::memory_attr::wb_pt;
+    mem_map->map_range(0ULL, 0ULL, tracked_len, mattr, ept::page_size_4k, ept::page_size_4k);
+
+    return mem_map;
+}
+
+// Fills the log the way the processor does: entries are written from the
+// top of the log page down, and the index is left one below the last entry
+
+static void
+log_pages(pml &p, const std::vector<uint64_t> &gpas)
+{
+    auto index = pml::num_entries - 1U;
+
+    for (const auto &gpa : gpas) {
+        p.m_log_page[index--] = gpa;
+    }
+
+    g_vmcs_fields[vmcs_n::guest_pml_index::addr] = index;
+}
+
+TEST_CASE("pml: drain partial log")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<test_ept::ept_test_support>(mocks);
+    auto mem_map = setup_mem_map();
+
+    auto hve = setup_hve();
+    pml p{hve.get(), *mem_map, 0ULL, tracked_len};
+
+    log_pages(p, {0x1000ULL, 0x2FFFULL, 0x1008ULL, tracked_len});
+    p.drain();
+
+    CHECK(p.dirty_pages() == 2U);
+    CHECK(p.m_bitmap[0] == 0x6ULL);
+    CHECK(g_vmcs_fields[vmcs_n::guest_pml_index::addr] == pml::num_entries - 1U);
+
+    p.drain();
+    CHECK(p.dirty_pages() == 2U);
+}
+
+TEST_CASE("pml: drain full log")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<test_ept::ept_test_support>(mocks);
+    auto mem_map = setup_mem_map();
+
+    auto hve = setup_hve();
+    pml p{hve.get(), *mem_map, 0ULL, tracked_len};
+
+    std::vector<uint64_t> gpas;
+    for (auto i = 0ULL; i < pml::num_entries; i++) {
+        gpas.push_back(i * ept::page_size_4k);
+    }
+
+    // Once the last entry is used, the 16 bit index wraps around to 0xFFFF
+
+    log_pages(p, gpas);
+    g_vmcs_fields[vmcs_n::guest_pml_index::addr] = 0xFFFFULL;
+    p.drain();
+
+    CHECK(p.dirty_pages() == pml::num_entries);
+    CHECK(g_vmcs_fields[vmcs_n::guest_pml_index::addr] == pml::num_entries - 1U);
+}
+
+TEST_CASE("pml: harvest")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<test_ept::ept_test_support>(mocks);
+    auto mem_map = setup_mem_map();
+
+    auto invepts = 0U;
+    mocks.OnCallFunc(_invept).Do([&](auto, auto) { invepts++; return true; });
+
+    auto hve = setup_hve();
+    pml p{hve.get(), *mem_map, 0ULL, tracked_len};
+
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(0x1000ULL));
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(0x41000ULL));
+    ept::epte::dirty::enable(mem_map->gpa_to_epte(0x2000ULL));
+
+    log_pages(p, {0x41000ULL, 0x1000ULL});
+    auto generation = mem_map->generation();
+
+    CHECK(p.harvest() == std::vector<uint64_t>{0x1000ULL, 0x41000ULL});
+    CHECK(p.dirty_pages() == 0U);
+    CHECK(ept::epte::dirty::is_disabled(mem_map->gpa_to_epte(0x1000ULL)));
+    CHECK(ept::epte::dirty::is_disabled(mem_map->gpa_to_epte(0x41000ULL)));
+    CHECK(ept::epte::dirty::is_enabled(mem_map->gpa_to_epte(0x2000ULL)));
+    CHECK(mem_map->generation() == generation + 1U);
+    CHECK(invepts == 1U);
+
+    CHECK(p.harvest().empty());
+    CHECK(invepts == 1U);
+}
+
+TEST_CASE("pml: invalid range")
+{
+    MockRepository mocks;
+    auto mock_ept = std::make_unique<test_ept::ept_test_support>(mocks);
+    auto mem_map = setup_mem_map();
+
+    auto hve = setup_hve();
+    CHECK_THROWS(pml(hve.get(), *mem_map, 0x1001ULL, tracked_len));
+    CHECK_THROWS(pml(hve.get(), *mem_map, 0ULL, 0ULL));
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,105 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <catch/catch.hpp>
+#include <hve/arch/intel_x64/base.h>
+
+#include <vector>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+struct record_t {
+    uint64_t val;
+};
+
+template<typename T>
+static std::vector<uint64_t>
+records(const T &log)
+{
+    std::vector<uint64_t> ret;
+
+    for (const auto &record : log) {
+        ret.push_back(record.val);
+    }
+
+    return ret;
+}
+
+TEST_CASE("ring_log: empty")
+{
+    ring_log<record_t, 4> log;
+
+    CHECK(log.empty());
+    CHECK(log.size() == 0);
+    CHECK(log.capacity() == 4);
+    CHECK(records(log).empty());
+}
+
+TEST_CASE("ring_log: push_back")
+{
+    ring_log<record_t, 4> log;
+
+    log.push_back({1});
+    log.push_back({2});
+
+    CHECK(!log.empty());
+    CHECK(log.size() == 2);
+    CHECK(records(log) == std::vector<uint64_t>({1, 2}));
+}
+
+TEST_CASE("ring_log: overwrites oldest")
+{
+    ring_log<record_t, 4> log;
+
+    for (auto i = 1ULL; i <= 6; i++) {
+        log.push_back({i});
+    }
+
+    CHECK(log.size() == 4);
+    CHECK(records(log) == std::vector<uint64_t>({3, 4, 5, 6}));
+}
+
+TEST_CASE("ring_log: tsc")
+{
+    ring_log<record_t, 4> log;
+
+    log.push_back({1});
+    log.push_back({2});
+
+    auto iter = log.begin();
+    const auto tsc = iter->tsc;
+
+    ++iter;
+    CHECK(iter->tsc >= tsc);
+}
+
+TEST_CASE("ring_log: move")
+{
+    ring_log<record_t, 4> log1;
+    log1.push_back({1});
+
+    auto log2 = std::move(log1);
+    CHECK(records(log2) == std::vector<uint64_t>({1}));
+}
+
+}
+}
@@ -0,0 +1,108 @@
+//
+// Bareflank Extended APIs
+//
+// Copyright (C) 2018 Assured Information Security, Inc.
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+
+#include <support/arch/intel_x64/vmcs_store.h>
+
+namespace eapis
+{
+namespace intel_x64
+{
+
+TEST_CASE("vmcs_store: read / write")
+{
+    vmcs_store store;
+    vmcs_store::value_type value = 1;
+
+    CHECK(store.read(vmcs_n::exit_reason::addr, &value));
+    CHECK(value == 0);
+
+    CHECK(store.write(vmcs_n::exit_reason::addr, 42));
+    CHECK(store.read(vmcs_n::exit_reason::addr, &value));
+    CHECK(value == 42);
+
+    CHECK(store.write(vmcs_n::guest_rip::addr, 0x1000));
+    CHECK(store.read(vmcs_n::guest_rip::addr, &value));
+    CHECK(value == 0x1000);
+
+    store.clear();
+    CHECK(store.read(vmcs_n::exit_reason::addr, &value));
+    CHECK(value == 0);
+}
+
+TEST_CASE("vmcs_store: invalid field")
+{
+    vmcs_store store;
+    vmcs_store::value_type value = 0;
+
+    CHECK_FALSE(store.write(vmcs_store::num_fields, 42));
+    CHECK_FALSE(store.read(vmcs_store::num_fields, &value));
+}
+
+TEST_CASE("msr_store: read / write")
+{
+    msr_store store;
+
+    CHECK(store.read(0x10) == 0);
+
+    store.write(0x10, 1);
+    store.write(0x1FFF, 2);
+    store.write(0xC0000080, 3);
+    store.write(0xC0001FFF, 4);
+    store.write(0x40000000, 5);
+
+    CHECK(store.read(0x10) == 1);
+    CHECK(store.read(0x1FFF) == 2);
+    CHECK(store.read(0xC0000080) == 3);
+    CHECK(store.read(0xC0001FFF) == 4);
+    CHECK(store.read(0x40000000) == 5);
+    CHECK(store.read(0x40000001) == 0);
+
+    store.clear();
+    CHECK(store.read(0x10) == 0);
+    CHECK(store.read(0xC0000080) == 0);
+    CHECK(store.read(0x40000000) == 0);
+}
+
+#ifdef _HIPPOMOCKS__ENABLE_CFUNC_MOCKING_SUPPORT
+
+TEST_CASE("setup_vmcs_store")
+{
+    MockRepository mocks;
+
+    g_vmcs_fields[vmcs_n::guest_rip::addr] = 0x1000;
+    g_msrs[0xC0000080] = 0x500;
+
+    auto guard = setup_vmcs_store(mocks);
+
+    CHECK(vmcs_n::guest_rip::get() == 0x1000);
+    CHECK(::intel_x64::msrs::get(0xC0000080) == 0x500);
+
+    vmcs_n::guest_rip::set(0x2000);
+    ::intel_x64::msrs::set(0xC0000080, 0xD01);
+
+    CHECK(vmcs_n::guest_rip::get() == 0x2000);
+    CHECK(::intel_x64::msrs::get(0xC0000080) == 0xD01);
+
+    CHECK(g_vmcs_fields[vmcs_n::guest_rip::addr] == 0x1000);
+    CHECK(g_msrs[0xC0000080] == 0x500);
+}
+
+#endif
+
+}
+}